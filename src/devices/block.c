@@ -3,7 +3,13 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Number of latency histogram buckets.  Bucket N counts requests
+   that took between 2**N and 2**(N+1) - 1 TSC cycles. */
+#define LAT_BUCKET_CNT 40
 
 /* A block device. */
 struct block
@@ -19,6 +25,18 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+
+    /* Detailed statistics, reported by block_dump_stats(). */
+    unsigned long long seq_cnt;         /* Requests for next_sector. */
+    block_sector_t next_sector;         /* Sector after last request. */
+    unsigned in_flight;                 /* Requests now in progress. */
+    unsigned max_in_flight;             /* Maximum of in_flight. */
+    unsigned long long depth_sum;       /* Sum of in_flight at issue. */
+    unsigned long long read_cycles;     /* Total cycles reading. */
+    unsigned long long write_cycles;    /* Total cycles writing. */
+    unsigned read_lat[LAT_BUCKET_CNT];  /* Read latency histogram. */
+    unsigned write_lat[LAT_BUCKET_CNT]; /* Write latency histogram. */
+    unsigned long long caller_cnt[BLOCK_CALLER_CNT]; /* Sectors per caller. */
   };
 
 /* List of all block devices. */
@@ -28,6 +46,9 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static uint64_t stats_begin (struct block *, block_sector_t);
+static void stats_end (struct block *, bool write, uint64_t start);
+static void print_histogram (const char *, const unsigned hist[]);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -120,9 +141,12 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
+  uint64_t start;
+
   check_sector (block, sector);
+  start = stats_begin (block, sector);
   block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  stats_end (block, false, start);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,12 +157,31 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  // printf("%d\n%d\n",block->size,sector);
+  uint64_t start;
+
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
+  start = stats_begin (block, sector);
   block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
-  // printf("BLOCK WRITE!!!\n");
+  stats_end (block, true, start);
+}
+
+/* Replaces BLOCK's driver operations and auxiliary data by OPS
+   and AUX, storing the previous ones in *OLD_OPS and *OLD_AUX.
+   This lets a driver stack on top of an existing block device
+   without its users noticing: requests go to OPS, which may pass
+   them down to *OLD_OPS with *OLD_AUX. */
+void
+block_interpose (struct block *block, const struct block_operations *ops,
+                 void *aux, const struct block_operations **old_ops,
+                 void **old_aux)
+{
+  enum intr_level old_level = intr_disable ();
+  *old_ops = block->ops;
+  *old_aux = block->aux;
+  block->ops = ops;
+  block->aux = aux;
+  intr_set_level (old_level);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -162,13 +205,26 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Sets the originator charged for block requests issued by the
+   running thread to CALLER and returns the previous one. */
+enum block_caller
+block_set_caller (enum block_caller caller)
+{
+  struct thread *t = thread_current ();
+  enum block_caller old = t->block_caller;
+
+  ASSERT (caller < BLOCK_CALLER_CNT);
+  t->block_caller = caller;
+  return old;
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
 {
   int i;
 
-  for (i = 0; i < BLOCK_CNT; i++)
+  for (i = 0; i < BLOCK_ROLE_CNT; i++)
     {
       struct block *block = block_by_role[i];
       if (block != NULL)
@@ -180,6 +236,61 @@ block_print_stats (void)
     }
 }
 
+/* Prints detailed statistics for each block device that has
+   been accessed: bytes transferred, sequential and random
+   request counts, queue depth, per-caller attribution, and
+   latency histograms.  Unlike block_print_stats(), this may be
+   called at any time, e.g. to snapshot a benchmark mid-run. */
+void
+block_dump_stats (void)
+{
+  static const char *caller_names[BLOCK_CALLER_CNT] =
+    {
+      "filesys",
+      "exec",
+      "swap",
+    };
+  struct list_elem *e;
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    {
+      struct block *block = list_entry (e, struct block, list_elem);
+      unsigned long long cnt = block->read_cnt + block->write_cnt;
+      int i;
+
+      if (cnt == 0)
+        continue;
+
+      printf ("%s (%s): %llu reads, %llu writes, ",
+              block->name, block_type_name (block->type),
+              block->read_cnt, block->write_cnt);
+      print_human_readable_size (cnt * BLOCK_SECTOR_SIZE);
+      printf (" transferred\n");
+      printf ("  %llu sequential, %llu random\n",
+              block->seq_cnt, cnt - block->seq_cnt);
+      printf ("  queue depth: %u now, %u max, %llu.%02llu average\n",
+              block->in_flight, block->max_in_flight,
+              block->depth_sum / cnt, block->depth_sum * 100 / cnt % 100);
+      printf ("  callers:");
+      for (i = 0; i < BLOCK_CALLER_CNT; i++)
+        printf (" %s %llu", caller_names[i], block->caller_cnt[i]);
+      printf ("\n");
+      if (block->read_cnt > 0)
+        {
+          printf ("  read latency: %llu cycles average\n",
+                  block->read_cycles / block->read_cnt);
+          print_histogram ("read", block->read_lat);
+        }
+      if (block->write_cnt > 0)
+        {
+          printf ("  write latency: %llu cycles average\n",
+                  block->write_cycles / block->write_cnt);
+          print_histogram ("write", block->write_lat);
+        }
+    }
+}
+
 /* Registers a new block device with the given NAME.  If
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
@@ -202,6 +313,16 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->seq_cnt = 0;
+  block->next_sector = 0;
+  block->in_flight = 0;
+  block->max_in_flight = 0;
+  block->depth_sum = 0;
+  block->read_cycles = 0;
+  block->write_cycles = 0;
+  memset (block->read_lat, 0, sizeof block->read_lat);
+  memset (block->write_lat, 0, sizeof block->write_lat);
+  memset (block->caller_cnt, 0, sizeof block->caller_cnt);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -223,3 +344,78 @@ list_elem_to_block (struct list_elem *list_elem)
           : NULL);
 }
 
+/* Returns the CPU's time-stamp counter.
+   See [IA32-v2b] "RDTSC". */
+static inline uint64_t
+read_tsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Records the start of a request for SECTOR on BLOCK and returns
+   the time at which it started, to be passed to stats_end(). */
+static uint64_t
+stats_begin (struct block *block, block_sector_t sector)
+{
+  enum block_caller caller;
+  enum intr_level old_level;
+
+  caller = (block->type == BLOCK_SWAP ? BLOCK_CALLER_SWAP
+            : thread_current ()->block_caller);
+
+  old_level = intr_disable ();
+  if (sector == block->next_sector)
+    block->seq_cnt++;
+  block->next_sector = sector + 1;
+  block->caller_cnt[caller]++;
+  block->depth_sum += ++block->in_flight;
+  if (block->in_flight > block->max_in_flight)
+    block->max_in_flight = block->in_flight;
+  intr_set_level (old_level);
+
+  return read_tsc ();
+}
+
+/* Records the completion of a read or, if WRITE is true, a
+   write request on BLOCK that was started at time START. */
+static void
+stats_end (struct block *block, bool write, uint64_t start)
+{
+  uint64_t cycles = read_tsc () - start;
+  enum intr_level old_level;
+  int bucket;
+
+  for (bucket = 0; bucket < LAT_BUCKET_CNT - 1; bucket++)
+    if (cycles >> (bucket + 1) == 0)
+      break;
+
+  old_level = intr_disable ();
+  block->in_flight--;
+  if (write)
+    {
+      block->write_cnt++;
+      block->write_cycles += cycles;
+      block->write_lat[bucket]++;
+    }
+  else
+    {
+      block->read_cnt++;
+      block->read_cycles += cycles;
+      block->read_lat[bucket]++;
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints the nonempty buckets of latency histogram HIST, labeled
+   with NAME. */
+static void
+print_histogram (const char *name, const unsigned hist[])
+{
+  int i;
+
+  for (i = 0; i < LAT_BUCKET_CNT; i++)
+    if (hist[i] != 0)
+      printf ("    %s 2^%d cycles: %u\n", name, i, hist[i]);
+}
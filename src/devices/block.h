@@ -41,6 +41,18 @@ enum block_type
 
 const char *block_type_name (enum block_type);
 
+/* Originator of a block device request, for statistics.
+   Requests to the swap device are always charged to
+   BLOCK_CALLER_SWAP; others are charged to whatever the issuing
+   thread last set with block_set_caller(). */
+enum block_caller
+  {
+    BLOCK_CALLER_FILESYS,        /* File system (the default). */
+    BLOCK_CALLER_EXEC,           /* Loading executables. */
+    BLOCK_CALLER_SWAP,           /* Paging to and from swap. */
+    BLOCK_CALLER_CNT             /* Number of callers. */
+  };
+
 /* Finding block devices. */
 struct block *block_get_role (enum block_type);
 void block_set_role (enum block_type, struct block *);
@@ -57,7 +69,9 @@ const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
 /* Statistics. */
+enum block_caller block_set_caller (enum block_caller);
 void block_print_stats (void);
+void block_dump_stats (void);
 
 /* Lower-level interface to block device drivers. */
 
@@ -70,5 +84,8 @@ struct block_operations
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_interpose (struct block *, const struct block_operations *,
+                      void *aux, const struct block_operations **old_ops,
+                      void **old_aux);
 
 #endif /* devices/block.h */
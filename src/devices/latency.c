@@ -0,0 +1,155 @@
+#include "devices/latency.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* The code in this file stacks on top of an existing block
+   device and delays each request by the time a mechanical disk
+   would take to service it.  Emulated disks answer almost
+   instantly no matter where the previous request left the
+   head, which hides the cost of poor locality from buffer cache,
+   allocation, and swap policies.
+
+   The model charges, for each request:
+
+     - A seek, unless the request is for the sector right after
+       the previous one.  Seek time grows with the square root of
+       the distance travelled, from a track-to-track seek of 1/20
+       of the full-stroke time up to the full-stroke time for a
+       move across the whole device.
+
+     - Half a revolution of rotational latency, on average, after
+       any seek.
+
+     - The time to transfer one sector at the media rate.
+
+   The delay is applied with timer_nsleep(), which sleeps if the
+   delay is at least a timer tick and busy-waits otherwise.
+   Requests to one device are serialized, like a disk with one
+   head. */
+
+/* A block device with injected latency. */
+struct latency
+  {
+    const struct block_operations *ops; /* Underlying driver. */
+    void *aux;                          /* Underlying driver data. */
+    block_sector_t size;                /* Device size in sectors. */
+
+    unsigned max_seek_us;       /* Full-stroke seek time. */
+    unsigned min_seek_us;       /* Track-to-track seek time. */
+    unsigned half_rotation_us;  /* Average rotational latency. */
+    unsigned xfer_ns;           /* Time to transfer one sector. */
+
+    struct lock lock;           /* Serializes requests. */
+    block_sector_t head;        /* Sector under the head. */
+  };
+
+static struct block_operations latency_operations;
+
+/* Stacks a latency model with parameters MODEL on top of BLOCK,
+   so that all further requests to BLOCK are delayed. */
+void
+latency_attach (struct block *block, const struct latency_model *model)
+{
+  struct latency *l;
+
+  ASSERT (model->rpm > 0 && model->mb_per_s > 0);
+
+  l = malloc (sizeof *l);
+  if (l == NULL)
+    PANIC ("Failed to allocate memory for latency model");
+
+  l->size = block_size (block);
+  l->max_seek_us = model->seek_ms * 1000;
+  l->min_seek_us = l->max_seek_us / 20;
+  l->half_rotation_us = 60 * 1000 * 1000 / model->rpm / 2;
+  l->xfer_ns = (BLOCK_SECTOR_SIZE * 1000) / model->mb_per_s;
+  lock_init (&l->lock);
+  l->head = 0;
+  block_interpose (block, &latency_operations, l, &l->ops, &l->aux);
+
+  printf ("%s: modeling %u ms seek, %u rpm, %u MB/s disk\n",
+          block_name (block), model->seek_ms, model->rpm, model->mb_per_s);
+}
+
+/* Returns the integer square root of X, rounded down. */
+static unsigned
+isqrt (unsigned x)
+{
+  unsigned root = 0;
+  unsigned bit = 1u << 30;
+
+  while (bit > x)
+    bit >>= 2;
+  while (bit != 0)
+    {
+      if (x >= root + bit)
+        {
+          x -= root + bit;
+          root = (root >> 1) + bit;
+        }
+      else
+        root >>= 1;
+      bit >>= 2;
+    }
+  return root;
+}
+
+/* Waits as long as L would take to service a request for
+   SECTOR, and moves the head past it.  Must be called with L's
+   lock held. */
+static void
+delay (struct latency *l, block_sector_t sector)
+{
+  int64_t us = 0;
+
+  if (sector != l->head)
+    {
+      block_sector_t distance = sector > l->head ? sector - l->head
+                                                 : l->head - sector;
+
+      /* Seek time, scaled by the square root of the fraction of
+         the device crossed, expressed in 1/256ths. */
+      unsigned fraction = (uint64_t) distance * 65536 / l->size;
+      us += l->min_seek_us + ((uint64_t) (l->max_seek_us - l->min_seek_us)
+                              * isqrt (fraction) / 256);
+      us += l->half_rotation_us;
+    }
+  l->head = sector + 1;
+
+  timer_nsleep (us * 1000 + l->xfer_ns);
+}
+
+/* Reads sector SECTOR from the underlying device of L_ into
+   BUFFER after the modeled delay. */
+static void
+latency_read (void *l_, block_sector_t sector, void *buffer)
+{
+  struct latency *l = l_;
+
+  lock_acquire (&l->lock);
+  delay (l, sector);
+  l->ops->read (l->aux, sector, buffer);
+  lock_release (&l->lock);
+}
+
+/* Writes sector SECTOR to the underlying device of L_ from
+   BUFFER after the modeled delay. */
+static void
+latency_write (void *l_, block_sector_t sector, const void *buffer)
+{
+  struct latency *l = l_;
+
+  lock_acquire (&l->lock);
+  delay (l, sector);
+  l->ops->write (l->aux, sector, buffer);
+  lock_release (&l->lock);
+}
+
+static struct block_operations latency_operations =
+  {
+    latency_read,
+    latency_write
+  };
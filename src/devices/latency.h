@@ -0,0 +1,16 @@
+#ifndef DEVICES_LATENCY_H
+#define DEVICES_LATENCY_H
+
+#include "devices/block.h"
+
+/* Parameters of a simple rotating disk model. */
+struct latency_model
+  {
+    unsigned seek_ms;           /* Full-stroke seek time. */
+    unsigned rpm;               /* Spindle speed. */
+    unsigned mb_per_s;          /* Media transfer rate. */
+  };
+
+void latency_attach (struct block *, const struct latency_model *);
+
+#endif /* devices/latency.h */
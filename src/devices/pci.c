@@ -0,0 +1,186 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+
+/* The code in this file enumerates devices on the PCI bus using
+   configuration mechanism #1, which is supported by every PC
+   chipset that Pintos can run on.  It does not configure
+   anything: it relies on the BIOS to have assigned I/O
+   addresses and interrupt lines, and records what it finds so
+   that drivers can look up their devices.  See [PCI] for
+   details. */
+
+/* Configuration mechanism #1 ports. */
+#define PCI_CONFIG_ADDR 0xcf8           /* Address register. */
+#define PCI_CONFIG_DATA 0xcfc           /* Data register. */
+
+/* Maximum number of PCI functions we keep track of. */
+#define PCI_MAX_DEVICES 32
+
+static struct pci_device devices[PCI_MAX_DEVICES];
+static size_t device_cnt;
+
+static uint32_t config_read (uint8_t bus, uint8_t slot, uint8_t func,
+                             uint8_t reg);
+static void probe_function (uint8_t bus, uint8_t slot, uint8_t func);
+
+/* Scans the PCI bus and records the functions present. */
+void
+pci_init (void)
+{
+  int bus, slot;
+
+  for (bus = 0; bus < 256; bus++)
+    for (slot = 0; slot < 32; slot++)
+      {
+        uint8_t header_type;
+        int func;
+
+        if ((config_read (bus, slot, 0, PCI_REG_ID) & 0xffff) == 0xffff)
+          continue;
+
+        /* Bit 7 of the header type marks a multifunction device. */
+        header_type = config_read (bus, slot, 0, PCI_REG_HEADER_TYPE & ~3)
+                      >> 16;
+        probe_function (bus, slot, 0);
+        if (header_type & 0x80)
+          for (func = 1; func < 8; func++)
+            probe_function (bus, slot, func);
+      }
+}
+
+/* Returns the first recorded PCI function after PREV with the
+   given VENDOR_ID and DEVICE_ID, or a null pointer if there are
+   no more.  Passing a null PREV starts from the first function. */
+struct pci_device *
+pci_find (uint16_t vendor_id, uint16_t device_id, struct pci_device *prev)
+{
+  struct pci_device *d;
+
+  for (d = prev != NULL ? prev + 1 : devices; d < devices + device_cnt; d++)
+    if (d->vendor_id == vendor_id && d->device_id == device_id)
+      return d;
+  return NULL;
+}
+
+/* Returns the 32-bit configuration register REG of D, which must
+   be 4-byte aligned. */
+uint32_t
+pci_read32 (const struct pci_device *d, uint8_t reg)
+{
+  ASSERT (reg % 4 == 0);
+  return config_read (d->bus, d->slot, d->func, reg);
+}
+
+/* Returns the 16-bit configuration register REG of D, which must
+   be 2-byte aligned. */
+uint16_t
+pci_read16 (const struct pci_device *d, uint8_t reg)
+{
+  ASSERT (reg % 2 == 0);
+  return pci_read32 (d, reg & ~3) >> ((reg & 3) * 8);
+}
+
+/* Returns the 8-bit configuration register REG of D. */
+uint8_t
+pci_read8 (const struct pci_device *d, uint8_t reg)
+{
+  return pci_read32 (d, reg & ~3) >> ((reg & 3) * 8);
+}
+
+/* Sets the 32-bit configuration register REG of D, which must be
+   4-byte aligned, to VALUE. */
+void
+pci_write32 (const struct pci_device *d, uint8_t reg, uint32_t value)
+{
+  enum intr_level old_level;
+
+  ASSERT (reg % 4 == 0);
+
+  old_level = intr_disable ();
+  outl (PCI_CONFIG_ADDR, (0x80000000 | (d->bus << 16) | (d->slot << 11)
+                          | (d->func << 8) | reg));
+  outl (PCI_CONFIG_DATA, value);
+  intr_set_level (old_level);
+}
+
+/* Sets the 16-bit configuration register REG of D, which must be
+   2-byte aligned, to VALUE. */
+void
+pci_write16 (const struct pci_device *d, uint8_t reg, uint16_t value)
+{
+  int shift = (reg & 2) * 8;
+  uint32_t word;
+
+  ASSERT (reg % 2 == 0);
+
+  word = pci_read32 (d, reg & ~3);
+  word = (word & ~(0xffffu << shift)) | ((uint32_t) value << shift);
+  pci_write32 (d, reg & ~3, word);
+}
+
+/* If base address register BAR of D describes an I/O port range,
+   stores its first port in *PORT and returns true.  Otherwise,
+   returns false. */
+bool
+pci_get_io_bar (const struct pci_device *d, int bar, uint16_t *port)
+{
+  uint32_t value;
+
+  ASSERT (bar >= 0 && bar < 6);
+
+  value = pci_read32 (d, PCI_REG_BAR0 + bar * 4);
+  if ((value & 1) == 0 || (value & ~3) == 0)
+    return false;
+  *port = value & ~3;
+  return true;
+}
+
+/* Reads configuration register REG, which must be 4-byte
+   aligned, from function FUNC of device SLOT on BUS. */
+static uint32_t
+config_read (uint8_t bus, uint8_t slot, uint8_t func, uint8_t reg)
+{
+  enum intr_level old_level;
+  uint32_t value;
+
+  old_level = intr_disable ();
+  outl (PCI_CONFIG_ADDR, (0x80000000 | (bus << 16) | (slot << 11)
+                          | (func << 8) | reg));
+  value = inl (PCI_CONFIG_DATA);
+  intr_set_level (old_level);
+
+  return value;
+}
+
+/* Records function FUNC of device SLOT on BUS, if present. */
+static void
+probe_function (uint8_t bus, uint8_t slot, uint8_t func)
+{
+  uint32_t id = config_read (bus, slot, func, PCI_REG_ID);
+  uint32_t class = config_read (bus, slot, func, PCI_REG_CLASS);
+  struct pci_device *d;
+
+  if ((id & 0xffff) == 0xffff)
+    return;
+  if (device_cnt >= PCI_MAX_DEVICES)
+    {
+      printf ("pci: too many devices, ignoring %02x:%02x.%x\n",
+              bus, slot, func);
+      return;
+    }
+
+  d = &devices[device_cnt++];
+  d->bus = bus;
+  d->slot = slot;
+  d->func = func;
+  d->vendor_id = id & 0xffff;
+  d->device_id = id >> 16;
+  d->class = class >> 24;
+  d->subclass = class >> 16;
+  d->irq = config_read (bus, slot, func, PCI_REG_IRQ_LINE);
+  if (d->irq == 0)
+    d->irq = 0xff;
+}
@@ -0,0 +1,45 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Standard configuration space registers. */
+#define PCI_REG_ID 0x00                 /* Vendor and device IDs. */
+#define PCI_REG_COMMAND 0x04            /* Command register. */
+#define PCI_REG_CLASS 0x08              /* Class, subclass, rev. */
+#define PCI_REG_HEADER_TYPE 0x0e        /* Header type. */
+#define PCI_REG_BAR0 0x10               /* First base address. */
+#define PCI_REG_IRQ_LINE 0x3c           /* Interrupt line. */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001               /* Respond to I/O space. */
+#define PCI_CMD_MEMORY 0x0002           /* Respond to memory space. */
+#define PCI_CMD_MASTER 0x0004           /* Enable bus mastering. */
+
+/* A function found on the PCI bus. */
+struct pci_device
+  {
+    uint8_t bus;                /* Bus number. */
+    uint8_t slot;               /* Device number on bus. */
+    uint8_t func;               /* Function number within device. */
+    uint16_t vendor_id;         /* Vendor ID. */
+    uint16_t device_id;         /* Device ID. */
+    uint8_t class;              /* Base class code. */
+    uint8_t subclass;           /* Subclass code. */
+    uint8_t irq;                /* Legacy IRQ line, or 0xff if none. */
+  };
+
+void pci_init (void);
+struct pci_device *pci_find (uint16_t vendor_id, uint16_t device_id,
+                             struct pci_device *prev);
+
+uint32_t pci_read32 (const struct pci_device *, uint8_t reg);
+uint16_t pci_read16 (const struct pci_device *, uint8_t reg);
+uint8_t pci_read8 (const struct pci_device *, uint8_t reg);
+void pci_write32 (const struct pci_device *, uint8_t reg, uint32_t);
+void pci_write16 (const struct pci_device *, uint8_t reg, uint16_t);
+
+bool pci_get_io_bar (const struct pci_device *, int bar, uint16_t *port);
+
+#endif /* devices/pci.h */
@@ -0,0 +1,84 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The code in this file implements block devices backed by
+   memory taken from the kernel page pool at boot.  They are
+   useful for benchmarking file system and virtual memory code
+   without the cost of an emulated disk, and for workloads that
+   need only ephemeral storage.  Their contents are lost at
+   shutdown. */
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    uint8_t *base;              /* First byte of storage. */
+    size_t page_cnt;            /* Number of pages of storage. */
+    struct lock lock;           /* Serializes sector accesses. */
+  };
+
+static struct block_operations ramdisk_operations;
+
+/* Creates and registers a zeroed RAM disk of at least SIZE_KB kB
+   in the given block device TYPE.  Panics if there is not enough
+   memory in the kernel pool.  Returns the new block device. */
+struct block *
+ramdisk_create (enum block_type type, size_t size_kb)
+{
+  static int ramdisk_cnt;
+  struct ramdisk *rd;
+  char name[16];
+
+  if (size_kb == 0)
+    PANIC ("RAM disk must not be empty");
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("Failed to allocate memory for RAM disk descriptor");
+
+  rd->page_cnt = DIV_ROUND_UP (size_kb * 1024, PGSIZE);
+  rd->base = palloc_get_multiple (PAL_ZERO, rd->page_cnt);
+  if (rd->base == NULL)
+    PANIC ("Not enough memory for %zu kB RAM disk (use pintos -m)",
+           size_kb);
+  lock_init (&rd->lock);
+
+  snprintf (name, sizeof name, "rd%d", ramdisk_cnt++);
+  return block_register (name, type, "RAM disk",
+                         rd->page_cnt * (PGSIZE / BLOCK_SECTOR_SIZE),
+                         &ramdisk_operations, rd);
+}
+
+/* Reads sector SEC_NO from RAM disk RD into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_read (void *rd_, block_sector_t sec_no, void *buffer)
+{
+  struct ramdisk *rd = rd_;
+  lock_acquire (&rd->lock);
+  memcpy (buffer, rd->base + sec_no * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+  lock_release (&rd->lock);
+}
+
+/* Write sector SEC_NO to RAM disk RD from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_write (void *rd_, block_sector_t sec_no, const void *buffer)
+{
+  struct ramdisk *rd = rd_;
+  lock_acquire (&rd->lock);
+  memcpy (rd->base + sec_no * BLOCK_SECTOR_SIZE, buffer, BLOCK_SECTOR_SIZE);
+  lock_release (&rd->lock);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write
+  };
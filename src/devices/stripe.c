@@ -0,0 +1,120 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+
+/* The code in this file implements a striped ("RAID-0") block
+   device that spreads its sectors across two or more underlying
+   block devices.
+
+   The stripe's sectors are divided into chunks of chunk_sectors
+   sectors each, and consecutive chunks are assigned to the
+   members in round-robin order:
+
+        member:      0         1         2         0    ...
+                +---------+---------+---------+---------+
+        chunk:  |    0    |    1    |    2    |    3    | ...
+                +---------+---------+---------+---------+
+
+   Each member brings its own driver-level locking, so requests
+   that land on members attached to different IDE channels
+   proceed in parallel when several threads are doing I/O at
+   once, e.g. during large sequential transfers split among
+   threads. */
+
+/* A stripe set. */
+struct stripe
+  {
+    struct block *members[STRIPE_MAX_MEMBERS]; /* Underlying devices. */
+    size_t member_cnt;                  /* Number of members. */
+    block_sector_t chunk_sectors;       /* Sectors per chunk. */
+  };
+
+static struct block_operations stripe_operations;
+
+/* Creates and registers a stripe set named NAME of the given
+   block device TYPE over the MEMBER_CNT devices in MEMBERS[],
+   with CHUNK_SECTORS sectors per chunk.  The stripe set's size
+   is that of the smallest member, rounded down to a whole number
+   of chunks, times MEMBER_CNT.  The members should not be used
+   directly afterward.  Panics on error.  Returns the new block
+   device. */
+struct block *
+stripe_create (const char *name, enum block_type type,
+               struct block *members[], size_t member_cnt,
+               block_sector_t chunk_sectors)
+{
+  struct stripe *s;
+  block_sector_t member_size;
+  char extra_info[128];
+  size_t i;
+
+  if (member_cnt < 2 || member_cnt > STRIPE_MAX_MEMBERS)
+    PANIC ("Stripe set needs 2 to %d devices", STRIPE_MAX_MEMBERS);
+  if (chunk_sectors == 0)
+    PANIC ("Stripe chunk size must be positive");
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    PANIC ("Failed to allocate memory for stripe set descriptor");
+  s->member_cnt = member_cnt;
+  s->chunk_sectors = chunk_sectors;
+
+  member_size = block_size (members[0]);
+  for (i = 0; i < member_cnt; i++)
+    {
+      s->members[i] = members[i];
+      if (block_size (members[i]) < member_size)
+        member_size = block_size (members[i]);
+    }
+  member_size -= member_size % chunk_sectors;
+  if (member_size == 0)
+    PANIC ("Stripe set members are smaller than one chunk");
+
+  snprintf (extra_info, sizeof extra_info,
+            "stripe of %zu devices, %"PRDSNu"-sector chunks",
+            member_cnt, chunk_sectors);
+  return block_register (name, type, extra_info, member_size * member_cnt,
+                         &stripe_operations, s);
+}
+
+/* Translates SECTOR within stripe set S into a member device,
+   returned, and a sector within that device, stored in
+   *MEMBER_SECTOR. */
+static struct block *
+map_sector (const struct stripe *s, block_sector_t sector,
+            block_sector_t *member_sector)
+{
+  block_sector_t chunk = sector / s->chunk_sectors;
+
+  *member_sector = (chunk / s->member_cnt * s->chunk_sectors
+                    + sector % s->chunk_sectors);
+  return s->members[chunk % s->member_cnt];
+}
+
+/* Reads sector SECTOR from stripe set S into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes. */
+static void
+stripe_read (void *s_, block_sector_t sector, void *buffer)
+{
+  block_sector_t member_sector;
+  struct block *member = map_sector (s_, sector, &member_sector);
+  block_read (member, member_sector, buffer);
+}
+
+/* Write sector SECTOR to stripe set S from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes.  Returns after the member
+   device has acknowledged receiving the data. */
+static void
+stripe_write (void *s_, block_sector_t sector, const void *buffer)
+{
+  block_sector_t member_sector;
+  struct block *member = map_sector (s_, sector, &member_sector);
+  block_write (member, member_sector, buffer);
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write
+  };
@@ -0,0 +1,14 @@
+#ifndef DEVICES_STRIPE_H
+#define DEVICES_STRIPE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Maximum number of devices in a stripe set. */
+#define STRIPE_MAX_MEMBERS 8
+
+struct block *stripe_create (const char *name, enum block_type,
+                             struct block *members[], size_t member_cnt,
+                             block_sector_t chunk_sectors);
+
+#endif /* devices/stripe.h */
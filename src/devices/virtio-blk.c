@@ -0,0 +1,396 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The code in this file is a driver for virtio block devices, as
+   provided by QEMU with "-drive if=virtio".  It speaks the legacy
+   (virtio 0.9.5) PCI interface, which every virtio-blk device
+   that QEMU emulates still offers.
+
+   Unlike the IDE driver, which has one command outstanding per
+   channel, a virtio disk accepts many requests at once through a
+   shared ring of descriptors.  Each request occupies a "slot"
+   with a fixed chain of three descriptors: a request header, the
+   sector data, and a status byte written by the device.  A
+   thread that submits a request sleeps on its slot's semaphore
+   until the interrupt handler finds the request in the device's
+   used ring, so several threads may have requests in flight on
+   the same disk. */
+
+/* PCI IDs of a transitional virtio block device. */
+#define VIRTIO_VENDOR_ID 0x1af4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+/* Legacy virtio registers, as offsets from I/O BAR 0. */
+#define REG_HOST_FEATURES 0x00          /* Device features (r/o). */
+#define REG_GUEST_FEATURES 0x04         /* Driver features. */
+#define REG_QUEUE_PFN 0x08              /* Queue page frame number. */
+#define REG_QUEUE_NUM 0x0c              /* Queue size (r/o). */
+#define REG_QUEUE_SEL 0x0e              /* Queue select. */
+#define REG_QUEUE_NOTIFY 0x10           /* Queue notify (w/o). */
+#define REG_STATUS 0x12                 /* Device status. */
+#define REG_ISR 0x13                    /* Interrupt status (r/o). */
+#define REG_CAPACITY 0x14               /* Capacity in sectors, 64 bits. */
+
+/* Device status bits. */
+#define STATUS_ACKNOWLEDGE 0x01         /* Guest noticed the device. */
+#define STATUS_DRIVER 0x02              /* Guest has a driver. */
+#define STATUS_DRIVER_OK 0x04           /* Driver is ready. */
+#define STATUS_FAILED 0x80              /* Driver gave up. */
+
+/* Descriptor flags. */
+#define DESC_NEXT 0x01                  /* Chain continues in NEXT. */
+#define DESC_WRITE 0x02                 /* Device writes the buffer. */
+
+/* Request types and status codes. */
+#define REQ_IN 0                        /* Read from disk. */
+#define REQ_OUT 1                       /* Write to disk. */
+#define REQ_STATUS_OK 0                 /* Success. */
+
+/* A descriptor in the descriptor table. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address of buffer. */
+    uint32_t len;               /* Buffer length in bytes. */
+    uint16_t flags;             /* DESC_* flags. */
+    uint16_t next;              /* Next descriptor if DESC_NEXT. */
+  };
+
+/* The ring of request chains offered to the device. */
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Next free entry in RING. */
+    uint16_t ring[];            /* Heads of descriptor chains. */
+  };
+
+/* The ring of request chains the device has finished. */
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Next entry the device will fill. */
+    struct
+      {
+        uint32_t id;            /* Head of finished chain. */
+        uint32_t len;           /* Bytes written by device. */
+      }
+    ring[];
+  };
+
+/* Header that starts every block request. */
+struct request_header
+  {
+    uint32_t type;              /* REQ_IN or REQ_OUT. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+
+/* Maximum number of requests in flight on a single disk. */
+#define SLOT_CNT 16
+
+/* A request slot.  Slot I owns descriptors 3*I through 3*I+2. */
+struct slot
+  {
+    struct request_header header;       /* Request header. */
+    uint8_t status;                     /* Written by the device. */
+    bool busy;                          /* In use by some thread? */
+    struct semaphore done;              /* Up'd by interrupt handler. */
+    uint8_t bounce[BLOCK_SECTOR_SIZE];  /* For user buffers. */
+  };
+
+/* A virtio block device. */
+struct virtio_disk
+  {
+    char name[8];               /* Name, e.g. "vda". */
+    uint16_t reg_base;          /* Base I/O port. */
+    uint8_t irq;                /* Interrupt vector in use. */
+
+    /* Virtqueue 0, in memory shared with the device. */
+    uint16_t queue_size;        /* Number of descriptors. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Available ring. */
+    struct vring_used *used;    /* Used ring. */
+    uint16_t used_idx;          /* Next used entry to process. */
+
+    struct lock lock;           /* Protects AVAIL and slot allocation. */
+    struct semaphore free_slots;        /* Number of idle slots. */
+    size_t slot_cnt;                    /* Number of usable slots. */
+    struct slot slots[SLOT_CNT];        /* Request slots. */
+  };
+
+/* Disks found so far. */
+#define DISK_MAX 8
+static struct virtio_disk *disks[DISK_MAX];
+static size_t disk_cnt;
+
+static struct block_operations virtio_blk_operations;
+
+static void init_disk (struct pci_device *);
+static void transfer (struct virtio_disk *, uint32_t type,
+                      block_sector_t, void *buffer);
+static void interrupt_handler (struct intr_frame *);
+
+/* Finds and initializes all virtio block devices. */
+void
+virtio_blk_init (void)
+{
+  struct pci_device *pci = NULL;
+
+  while ((pci = pci_find (VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, pci))
+         != NULL)
+    {
+      if (disk_cnt >= DISK_MAX)
+        {
+          printf ("virtio-blk: too many disks\n");
+          break;
+        }
+      init_disk (pci);
+    }
+}
+
+/* Returns the number of bytes needed for a virtqueue with
+   QUEUE_SIZE descriptors, laid out as the legacy interface
+   requires: the descriptor table and available ring, then the
+   used ring starting on a new page. */
+static size_t
+vring_size (uint16_t queue_size)
+{
+  return (ROUND_UP (sizeof (struct vring_desc) * queue_size
+                    + sizeof (uint16_t) * (3 + queue_size), PGSIZE)
+          + ROUND_UP (sizeof (uint16_t) * 3
+                      + sizeof ((struct vring_used *) 0)->ring[0]
+                        * queue_size, PGSIZE));
+}
+
+/* Initializes the virtio block device described by PCI and
+   registers it as a block device. */
+static void
+init_disk (struct pci_device *pci)
+{
+  static bool irq_registered[16];
+  struct virtio_disk *d;
+  struct block *block;
+  uint16_t reg_base;
+  uint8_t *queue;
+  uint64_t capacity;
+  size_t i;
+  char extra_info[64];
+
+  if (!pci_get_io_bar (pci, 0, &reg_base) || pci->irq >= 16)
+    {
+      printf ("virtio-blk: device %02x:%02x.%x is not usable\n",
+              pci->bus, pci->slot, pci->func);
+      return;
+    }
+  pci_write16 (pci, PCI_REG_COMMAND,
+               (pci_read16 (pci, PCI_REG_COMMAND)
+                | PCI_CMD_IO | PCI_CMD_MASTER));
+
+  d = malloc (sizeof *d);
+  if (d == NULL)
+    PANIC ("Failed to allocate memory for virtio disk descriptor");
+  snprintf (d->name, sizeof d->name, "vd%c", 'a' + (int) disk_cnt);
+  d->reg_base = reg_base;
+  d->irq = pci->irq + 0x20;
+
+  /* Reset the device and tell it that we have a driver.  We need
+     no optional features. */
+  outb (d->reg_base + REG_STATUS, 0);
+  outb (d->reg_base + REG_STATUS, STATUS_ACKNOWLEDGE);
+  outb (d->reg_base + REG_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  inl (d->reg_base + REG_HOST_FEATURES);
+  outl (d->reg_base + REG_GUEST_FEATURES, 0);
+
+  /* Set up the request queue in physically contiguous memory. */
+  outw (d->reg_base + REG_QUEUE_SEL, 0);
+  d->queue_size = inw (d->reg_base + REG_QUEUE_NUM);
+  queue = NULL;
+  if (d->queue_size >= 3)
+    queue = palloc_get_multiple (PAL_ZERO,
+                                 vring_size (d->queue_size) / PGSIZE);
+  if (queue == NULL)
+    {
+      printf ("%s: cannot set up request queue\n", d->name);
+      outb (d->reg_base + REG_STATUS, STATUS_FAILED);
+      free (d);
+      return;
+    }
+  d->desc = (struct vring_desc *) queue;
+  d->avail = (struct vring_avail *) (queue + sizeof (struct vring_desc)
+                                     * d->queue_size);
+  d->used = (struct vring_used *)
+    (queue + ROUND_UP (sizeof (struct vring_desc) * d->queue_size
+                       + sizeof (uint16_t) * (3 + d->queue_size), PGSIZE));
+  d->used_idx = 0;
+  outl (d->reg_base + REG_QUEUE_PFN, vtop (queue) >> PGBITS);
+
+  /* Set up request slots, each with a fixed descriptor chain. */
+  lock_init (&d->lock);
+  d->slot_cnt = d->queue_size / 3 < SLOT_CNT ? d->queue_size / 3 : SLOT_CNT;
+  sema_init (&d->free_slots, d->slot_cnt);
+  for (i = 0; i < d->slot_cnt; i++)
+    {
+      struct slot *s = &d->slots[i];
+      struct vring_desc *chain = &d->desc[i * 3];
+
+      s->busy = false;
+      sema_init (&s->done, 0);
+
+      chain[0].addr = vtop (&s->header);
+      chain[0].len = sizeof s->header;
+      chain[0].flags = DESC_NEXT;
+      chain[0].next = i * 3 + 1;
+
+      chain[1].len = BLOCK_SECTOR_SIZE;
+      chain[1].next = i * 3 + 2;
+
+      chain[2].addr = vtop (&s->status);
+      chain[2].len = sizeof s->status;
+      chain[2].flags = DESC_WRITE;
+    }
+
+  disks[disk_cnt++] = d;
+  if (!irq_registered[pci->irq])
+    {
+      intr_register_ext (d->irq, interrupt_handler, "virtio-blk");
+      irq_registered[pci->irq] = true;
+    }
+  outb (d->reg_base + REG_STATUS,
+        STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+
+  /* Register the disk, clamping its capacity to what a
+     block_sector_t can express. */
+  capacity = inl (d->reg_base + REG_CAPACITY);
+  capacity |= (uint64_t) inl (d->reg_base + REG_CAPACITY + 4) << 32;
+  if (capacity > (block_sector_t) -1)
+    capacity = (block_sector_t) -1;
+  snprintf (extra_info, sizeof extra_info,
+            "virtio-blk, queue size %"PRIu16", %zu slots",
+            d->queue_size, d->slot_cnt);
+  block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
+                          &virtio_blk_operations, d);
+  partition_scan (block);
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+virtio_blk_read (void *d_, block_sector_t sec_no, void *buffer)
+{
+  transfer (d_, REQ_IN, sec_no, buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+virtio_blk_write (void *d_, block_sector_t sec_no, const void *buffer)
+{
+  transfer (d_, REQ_OUT, sec_no, (void *) buffer);
+}
+
+static struct block_operations virtio_blk_operations =
+  {
+    virtio_blk_read,
+    virtio_blk_write
+  };
+
+/* Submits a request of the given TYPE for sector SEC_NO of D,
+   with BUFFER as the source or destination, and waits for it to
+   complete.  BUFFER may be in user memory, in which case the
+   data passes through the slot's bounce buffer, because the
+   device needs a physical address. */
+static void
+transfer (struct virtio_disk *d, uint32_t type, block_sector_t sec_no,
+          void *buffer)
+{
+  bool bounce = !is_kernel_vaddr (buffer);
+  struct slot *s;
+  size_t head;
+
+  /* Claim an idle slot. */
+  sema_down (&d->free_slots);
+  lock_acquire (&d->lock);
+  for (s = d->slots; s->busy; s++)
+    continue;
+  ASSERT (s < d->slots + d->slot_cnt);
+  s->busy = true;
+  lock_release (&d->lock);
+  head = (s - d->slots) * 3;
+
+  /* Fill in the request. */
+  s->header.type = type;
+  s->header.reserved = 0;
+  s->header.sector = sec_no;
+  s->status = 0xff;
+  if (bounce && type == REQ_OUT)
+    memcpy (s->bounce, buffer, BLOCK_SECTOR_SIZE);
+  d->desc[head + 1].addr = vtop (bounce ? s->bounce : buffer);
+  d->desc[head + 1].flags = DESC_NEXT | (type == REQ_IN ? DESC_WRITE : 0);
+
+  /* Offer it to the device. */
+  lock_acquire (&d->lock);
+  d->avail->ring[d->avail->idx % d->queue_size] = head;
+  barrier ();
+  d->avail->idx++;
+  barrier ();
+  outw (d->reg_base + REG_QUEUE_NOTIFY, 0);
+  lock_release (&d->lock);
+
+  /* Wait for completion. */
+  sema_down (&s->done);
+  if (s->status != REQ_STATUS_OK)
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+           type == REQ_IN ? "read" : "write", sec_no);
+  if (bounce && type == REQ_IN)
+    memcpy (buffer, s->bounce, BLOCK_SECTOR_SIZE);
+
+  /* Release the slot. */
+  lock_acquire (&d->lock);
+  s->busy = false;
+  lock_release (&d->lock);
+  sema_up (&d->free_slots);
+}
+
+/* Virtio interrupt handler.  Wakes up the thread waiting on each
+   request that the device has completed. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++)
+    {
+      struct virtio_disk *d = disks[i];
+
+      /* Reading the ISR acknowledges the interrupt. */
+      if (f->vec_no != d->irq || (inb (d->reg_base + REG_ISR) & 1) == 0)
+        continue;
+
+      barrier ();
+      while (d->used_idx != d->used->idx)
+        {
+          uint32_t id = d->used->ring[d->used_idx % d->queue_size].id;
+          sema_up (&d->slots[id / 3].done);
+          d->used_idx++;
+          barrier ();
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/* lat.c
+
+   Measures, in CPU cycles, the cost of a null system call and of
+   a fork() followed by the child's exit() and the parent's
+   wait(), which includes two address space switches.  Compare a
+   kernel booted normally with one booted with -small-pages to
+   see what large and global kernel pages save.
+
+   fork() needs a kernel with VM.
+
+   Usage: lat [ITERATIONS] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : 10000;
+  uint64_t start;
+  int i;
+
+  if (iterations <= 0)
+    {
+      printf ("usage: lat [ITERATIONS]\n");
+      return EXIT_FAILURE;
+    }
+
+  /* An invalid file descriptor makes tell() return at once. */
+  start = rdtsc ();
+  for (i = 0; i < iterations; i++)
+    tell (-1);
+  printf ("null syscall: %llu cycles\n", (rdtsc () - start) / iterations);
+
+  start = rdtsc ();
+  for (i = 0; i < iterations / 100 + 1; i++)
+    {
+      pid_t pid = fork ();
+      if (pid == 0)
+        exit (0);
+      if (pid == PID_ERROR)
+        {
+          printf ("fork failed\n");
+          return EXIT_FAILURE;
+        }
+      wait (pid);
+    }
+  printf ("fork+exit+wait: %llu cycles\n",
+          (rdtsc () - start) / (iterations / 100 + 1));
+  return EXIT_SUCCESS;
+}
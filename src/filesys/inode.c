@@ -77,6 +77,7 @@ struct inode
   int open_cnt;                       /* Number of openers. */
   bool removed;                       /* True if deleted, false otherwise. */
   int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+  unsigned write_cnt;                 /* Number of writes so far. */
   struct inode_disk data;             /* Inode content. */
   block_sector_t parent;
   bool dir;
@@ -266,6 +267,7 @@ inode_open (block_sector_t sector)
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->write_cnt = 0;
   inode->removed = false;
   block_read(fs_device, inode->sector, &inode->data);
 
@@ -418,6 +420,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   if (inode->deny_write_cnt)
     return 0;
+  inode->write_cnt++;
   int i=0;
   while (size > 0) 
   {
@@ -511,6 +514,15 @@ inode_allow_write (struct inode *inode)
   inode->deny_write_cnt--;
 }
 
+/* Returns the number of times INODE has been written since it
+   was opened, which callers may compare to detect changes while
+   they keep it open. */
+unsigned
+inode_write_cnt (const struct inode *inode)
+{
+  return inode->write_cnt;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -0,0 +1,147 @@
+#include <lz.h>
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* The compressor remembers where the most recent occurrence of
+   each 3-byte sequence began in a hash table of this many
+   entries, and looks there for a match.  Only one candidate is
+   tried per position, which keeps compression fast at some cost
+   in compression ratio. */
+#define HASH_BITS 10
+#define HASH_SIZE (1 << HASH_BITS)
+
+#define MAX_LITERALS 0x80                   /* Longest literal run. */
+#define MAX_MATCH (0x7f + LZ_MIN_MATCH)     /* Longest copy. */
+#define MAX_DISTANCE 0xffff                 /* Farthest copy. */
+
+/* Returns the hash table index for the 3 bytes at P. */
+static inline size_t
+hash (const uint8_t *p)
+{
+  uint32_t seq = p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16);
+  return (seq * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends the CNT literal bytes at SRC to the DST_SIZE-byte
+   buffer DST, of which *OUT bytes are already used, and updates
+   *OUT.  Returns false if DST is too small. */
+static bool
+put_literals (const uint8_t *src, size_t cnt,
+              uint8_t *dst, size_t dst_size, size_t *out)
+{
+  while (cnt > 0)
+    {
+      size_t run = cnt < MAX_LITERALS ? cnt : MAX_LITERALS;
+      if (dst_size - *out < run + 1)
+        return false;
+      dst[(*out)++] = run - 1;
+      memcpy (dst + *out, src, run);
+      *out += run;
+      src += run;
+      cnt -= run;
+    }
+  return true;
+}
+
+/* Compresses the SRC_SIZE bytes at SRC into the DST_SIZE-byte
+   buffer DST, using the LZ_WORK_SIZE bytes at WORK as scratch
+   space.  Returns the size of the compressed data, or 0 if it
+   would not fit in DST_SIZE bytes.  SRC_SIZE must be less than
+   64 kB. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst_, size_t dst_size, void *work)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  uint16_t *table = work;
+  size_t in = 0;                /* Next input byte to examine. */
+  size_t literal = 0;           /* First input byte not yet output. */
+  size_t out = 0;               /* Bytes of output so far. */
+
+  ASSERT (src_size <= UINT16_MAX);
+  ASSERT (sizeof *table * HASH_SIZE <= LZ_WORK_SIZE);
+
+  memset (table, 0, sizeof *table * HASH_SIZE);
+  while (in + LZ_MIN_MATCH <= src_size)
+    {
+      size_t h = hash (src + in);
+      size_t match = table[h];
+      table[h] = in;
+
+      if (match < in && in - match <= MAX_DISTANCE
+          && !memcmp (src + match, src + in, LZ_MIN_MATCH))
+        {
+          size_t distance = in - match;
+          size_t len = LZ_MIN_MATCH;
+
+          while (in + len < src_size && len < MAX_MATCH
+                 && src[match + len] == src[in + len])
+            len++;
+
+          if (!put_literals (src + literal, in - literal,
+                             dst, dst_size, &out)
+              || dst_size - out < 3)
+            return 0;
+          dst[out++] = 0x80 | (len - LZ_MIN_MATCH);
+          dst[out++] = distance & 0xff;
+          dst[out++] = distance >> 8;
+          in += len;
+          literal = in;
+        }
+      else
+        in++;
+    }
+
+  if (!put_literals (src + literal, src_size - literal,
+                     dst, dst_size, &out))
+    return 0;
+  return out;
+}
+
+/* Decompresses the SRC_SIZE bytes of compressed data at SRC into
+   the DST_SIZE-byte buffer DST.  Returns the number of bytes
+   produced, or 0 if the data is malformed or does not fit. */
+size_t
+lz_decompress (const void *src_, size_t src_size,
+               void *dst_, size_t dst_size)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < src_size)
+    {
+      uint8_t c = src[in++];
+      if (c < 0x80)
+        {
+          size_t run = c + 1;
+          if (src_size - in < run || dst_size - out < run)
+            return 0;
+          memcpy (dst + out, src + in, run);
+          in += run;
+          out += run;
+        }
+      else
+        {
+          size_t len = (c & 0x7f) + LZ_MIN_MATCH;
+          size_t distance;
+          size_t i;
+
+          if (src_size - in < 2)
+            return 0;
+          distance = src[in] | (src[in + 1] << 8);
+          in += 2;
+          if (distance == 0 || distance > out || dst_size - out < len)
+            return 0;
+
+          /* Byte by byte, because the copy may overlap. */
+          for (i = 0; i < len; i++, out++)
+            dst[out] = dst[out - distance];
+        }
+    }
+  return out;
+}
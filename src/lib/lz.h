@@ -0,0 +1,27 @@
+#ifndef __LIB_LZ_H
+#define __LIB_LZ_H
+
+/* A small, fast Lempel-Ziv compressor.
+
+   Compressed data is a sequence of items, each introduced by a
+   control byte C.  If C < 0x80, C + 1 literal bytes follow.
+   Otherwise, the item is a copy of (C & 0x7f) + LZ_MIN_MATCH
+   bytes from earlier in the output, at the distance given by
+   the two bytes that follow, least significant first.  The copy
+   may overlap the bytes it produces, so that a run of repeated
+   bytes compresses to a few items. */
+
+#include <stddef.h>
+
+/* Shortest copy worth encoding. */
+#define LZ_MIN_MATCH 3
+
+/* Bytes of scratch memory needed by lz_compress(). */
+#define LZ_WORK_SIZE 2048
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, void *work);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/lz.h */
@@ -28,7 +28,12 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_BLKSTATS,               /* Prints block device statistics. */
+    SYS_FORK,                   /* Duplicate the running process. */
+    SYS_CHECKPOINT              /* Save the running process to a file. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -182,3 +182,21 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+void
+blkstats (void)
+{
+  syscall0 (SYS_BLKSTATS);
+}
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+int
+checkpoint (const char *file)
+{
+  return syscall1 (SYS_CHECKPOINT, file);
+}
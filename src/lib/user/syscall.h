@@ -45,4 +45,9 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+void blkstats (void);
+pid_t fork (void);
+int checkpoint (const char *file);
+
 #endif /* lib/user/syscall.h */
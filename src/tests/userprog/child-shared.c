@@ -0,0 +1,15 @@
+/* Child process run by exec-shared and exec-shared-missing tests.
+   Same as child-simple, but linked with the shared C library,
+   so that the kernel must load libc.so to run it. */
+
+#include <stdio.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-shared";
+
+int
+main (void) 
+{
+  msg ("run");
+  return 81;
+}
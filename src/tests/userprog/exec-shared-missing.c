@@ -0,0 +1,13 @@
+/* Tries to execute a process that is linked with the shared C
+   library when the library is not on the file system.
+   The exec system call must return -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  msg ("exec(\"child-shared\"): %d", exec ("child-shared"));
+}
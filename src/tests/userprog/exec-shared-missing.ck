@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF', <<'EOF']);
+(exec-shared-missing) begin
+load: libc.so: open failed
+(exec-shared-missing) exec("child-shared"): -1
+(exec-shared-missing) end
+exec-shared-missing: exit(0)
+EOF
+(exec-shared-missing) begin
+load: libc.so: open failed
+child-shared: exit(-1)
+(exec-shared-missing) exec("child-shared"): -1
+(exec-shared-missing) end
+exec-shared-missing: exit(0)
+EOF
+(exec-shared-missing) begin
+load: libc.so: open failed
+(exec-shared-missing) exec("child-shared"): -1
+child-shared: exit(-1)
+(exec-shared-missing) end
+exec-shared-missing: exit(0)
+EOF
+pass;
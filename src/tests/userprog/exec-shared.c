@@ -0,0 +1,12 @@
+/* Executes and waits for a child process that is linked with the
+   shared C library. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  wait (exec ("child-shared"));
+}
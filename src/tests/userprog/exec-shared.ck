@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exec-shared) begin
+(child-shared) run
+child-shared: exit(81)
+(exec-shared) end
+exec-shared: exit(0)
+EOF
+pass;
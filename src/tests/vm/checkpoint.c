@@ -0,0 +1,64 @@
+/* Saves a checkpoint of a process that has files open part way
+   through, one of them under a name as long as the file system
+   allows, then runs the checkpoint and verifies that the resumed
+   process finds its memory and its place in each file as they
+   were. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+/* A name of exactly NAME_MAX characters. */
+#define LONG_NAME "checkpoint.dat"
+#define LONG_POS 100
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  char head[16];
+  char tail[sizeof sample - 1 - sizeof head];
+  int handle, long_handle, result;
+  pid_t child;
+  size_t i;
+
+  memset (buf, 0x5a, sizeof buf);
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, head, sizeof head) == (int) sizeof head,
+         "read \"sample.txt\"");
+  CHECK (create (LONG_NAME, 512), "create \"" LONG_NAME "\"");
+  CHECK ((long_handle = open (LONG_NAME)) > 1, "open \"" LONG_NAME "\"");
+  seek (long_handle, LONG_POS);
+
+  result = checkpoint ("saved");
+  if (result == 1)
+    {
+      /* Resumed from the checkpoint. */
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 0x5a)
+          fail ("byte %zu is %02hhx instead of 5a", i, buf[i]);
+      if (read (handle, tail, sizeof tail) != (int) sizeof tail
+          || memcmp (tail, sample + sizeof head, sizeof tail))
+        fail ("read after resuming did not continue where it left off");
+      if (tell (long_handle) != LONG_POS)
+        fail ("\"" LONG_NAME "\" is at %u after resuming instead of %d",
+              tell (long_handle), LONG_POS);
+      exit (81);
+    }
+  CHECK (result == 0, "checkpoint");
+
+  /* Free the handles for the resumed process, and change memory
+     that it should not see. */
+  close (handle);
+  close (long_handle);
+  memset (buf, 0x33, sizeof buf);
+
+  msg ("run checkpoint");
+  child = exec ("saved");
+  CHECK (wait (child) == 81, "wait for resumed process");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(checkpoint) begin
+(checkpoint) open "sample.txt"
+(checkpoint) read "sample.txt"
+(checkpoint) create "checkpoint.dat"
+(checkpoint) open "checkpoint.dat"
+(checkpoint) checkpoint
+(checkpoint) run checkpoint
+saved: exit(81)
+(checkpoint) wait for resumed process
+(checkpoint) end
+checkpoint: exit(0)
+EOF
+pass;
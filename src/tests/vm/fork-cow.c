@@ -0,0 +1,48 @@
+/* Forks a child and has both processes overwrite a large array
+   that they start out sharing copy-on-write, then verifies that
+   neither sees the other's writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (256 * 1024)
+
+static char buf[SIZE];
+
+/* Fails unless every byte of buf is VALUE. */
+static void
+check_buf (char value)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != value)
+      fail ("byte %zu is %02hhx instead of %02hhx", i, buf[i], value);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  memset (buf, 0x5a, sizeof buf);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      check_buf (0x5a);
+      memset (buf, 0xa5, sizeof buf);
+      check_buf (0xa5);
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork returned -1");
+
+  memset (buf, 0x33, sizeof buf);
+  CHECK (wait (child) == 81, "wait for child");
+  check_buf (0x33);
+  msg ("parent's copy is intact");
+}
@@ -0,0 +1,48 @@
+/* Forks a child that reads and seeks a file its parent opened.
+   File descriptors are global, so the two processes share the
+   file's position: each continues from where the other left
+   off. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char head[16];
+  char tail[sizeof sample - 1 - sizeof head];
+  int handle;
+  pid_t child;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, head, sizeof head) == (int) sizeof head,
+         "read \"sample.txt\"");
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      if (tell (handle) != sizeof head)
+        fail ("child's position is %u instead of %zu",
+              tell (handle), sizeof head);
+      if (read (handle, tail, sizeof tail) != (int) sizeof tail
+          || memcmp (tail, sample + sizeof head, sizeof tail))
+        fail ("child did not continue where its parent left off");
+      seek (handle, sizeof head);
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork returned -1");
+
+  CHECK (wait (child) == 81, "wait for child");
+  CHECK (tell (handle) == sizeof head, "tell \"sample.txt\"");
+  CHECK (read (handle, tail, sizeof tail) == (int) sizeof tail,
+         "read \"sample.txt\"");
+  if (memcmp (tail, sample + sizeof head, sizeof tail))
+    fail ("read did not continue from the child's seek");
+  msg ("positions are shared");
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-file) begin
+(fork-file) open "sample.txt"
+(fork-file) read "sample.txt"
+(fork-file) fork
+fork-file: exit(81)
+(fork-file) wait for child
+(fork-file) tell "sample.txt"
+(fork-file) read "sample.txt"
+(fork-file) positions are shared
+(fork-file) end
+fork-file: exit(0)
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Fills a buffer of several pages with identical contents, waits
+   long enough for the kernel to merge them into one frame, then
+   writes the buffer to a file and reads it back.  The pages of
+   the buffer then share a frame while write() holds them in
+   memory. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 4096)
+
+/* Enough iterations to span several passes of the merging
+   thread, which runs once a second. */
+#define SPIN_CNT 500000000
+
+static char buf[SIZE];
+static char copy[SIZE];
+
+void
+test_main (void)
+{
+  volatile unsigned spin;
+  int handle;
+  size_t i;
+
+  memset (buf, 0x5a, sizeof buf);
+  msg ("wait for pages to merge");
+  for (spin = 0; spin < SPIN_CNT; spin++)
+    continue;
+
+  CHECK (create ("merged", SIZE), "create \"merged\"");
+  CHECK ((handle = open ("merged")) > 1, "open \"merged\"");
+  CHECK (write (handle, buf, SIZE) == SIZE, "write \"merged\"");
+
+  seek (handle, 0);
+  CHECK (read (handle, copy, SIZE) == SIZE, "read \"merged\"");
+  for (i = 0; i < SIZE; i++)
+    if (copy[i] != 0x5a)
+      fail ("byte %zu is %02hhx instead of 5a", i, copy[i]);
+  msg ("file matches buffer");
+  close (handle);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(page-merge-write) begin
+(page-merge-write) wait for pages to merge
+(page-merge-write) create "merged"
+(page-merge-write) open "merged"
+(page-merge-write) write "merged"
+(page-merge-write) read "merged"
+(page-merge-write) file matches buffer
+(page-merge-write) end
+page-merge-write: exit(0)
+EOF
+pass;
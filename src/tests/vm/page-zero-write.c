@@ -0,0 +1,34 @@
+/* Writes a buffer of several pages that the process has never
+   touched, so that all of them share the frame of zeros while
+   write() holds them in memory, then reads the file back to
+   verify that it holds only zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 4096)
+
+static char zeros[SIZE];
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  int handle;
+  size_t i;
+
+  CHECK (create ("zeros", SIZE), "create \"zeros\"");
+  CHECK ((handle = open ("zeros")) > 1, "open \"zeros\"");
+  CHECK (write (handle, zeros, SIZE) == SIZE, "write \"zeros\"");
+
+  memset (buf, 0x5a, sizeof buf);
+  seek (handle, 0);
+  CHECK (read (handle, buf, SIZE) == SIZE, "read \"zeros\"");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is %02hhx instead of 00", i, buf[i]);
+  msg ("file holds only zeros");
+  close (handle);
+}
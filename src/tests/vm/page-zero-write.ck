@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(page-zero-write) begin
+(page-zero-write) create "zeros"
+(page-zero-write) open "zeros"
+(page-zero-write) write "zeros"
+(page-zero-write) read "zeros"
+(page-zero-write) file holds only zeros
+(page-zero-write) end
+page-zero-write: exit(0)
+EOF
+pass;
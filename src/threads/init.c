@@ -34,9 +34,21 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/latency.h"
+#include "devices/pci.h"
+#include "devices/ramdisk.h"
+#include "devices/stripe.h"
+#include "devices/virtio-blk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/merge.h"
+#include "vm/page.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -46,18 +58,35 @@ uint32_t *init_page_dir;
 static bool format_filesys;
 
 /* -filesys, -scratch, -swap: Names of block devices to use,
-   overriding the defaults. */
+   overriding the defaults.  A name of the form "ram:SIZE" asks
+   for a new RAM disk of SIZE kB instead. */
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -stripe: Comma-separated names of block devices to combine
+   into a striped file system device.
+   -stripe-chunk: Sectors per stripe chunk. */
+static char *stripe_bdev_names;
+static block_sector_t stripe_chunk_sectors = 8;
+
+/* -latency: Comma-separated names of block devices to slow down
+   to the speed of a mechanical disk.
+   -latency-model: Parameters of the disk model. */
+static char *latency_bdev_names;
+static struct latency_model latency_model = {15, 7200, 50};
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
+/* -small-pages: Map kernel memory with 4 kB pages only, and not
+   global, e.g. as a baseline for measurements. */
+static bool small_pages;
+
 static void paging_init (void);
 
 static char **read_command_line (void);
@@ -66,6 +95,9 @@ static void run_actions (char **argv);
 static void usage (void);
 
 #ifdef FILESYS
+static void create_stripe (void);
+static void set_latency_model (char *);
+static void add_latency (void);
 static void locate_block_devices (void);
 static void locate_block_device (enum block_type, const char *name);
 #endif
@@ -119,14 +151,27 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+#ifdef USERPROG
+  process_init ();
+#endif
 
 #ifdef FILESYS
   /* Initialize file system. */
+  pci_init ();
   ide_init ();
+  virtio_blk_init ();
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  share_init ();
+  swap_init ();
+  merge_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -150,16 +195,44 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CPUID leaf 1 feature flags in EDX.  See [IA32-v2a] "CPUID". */
+#define CPUID_PSE (1 << 3)      /* 4 MB pages. */
+#define CPUID_PGE (1 << 13)     /* Global pages. */
+
+/* CR4 bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x10            /* Page Size Extensions. */
+#define CR4_PGE 0x80            /* Page Global Enable. */
+
+/* Returns the CPU's feature flags from CPUID leaf 1, EDX. */
+static uint32_t
+cpu_features (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return edx;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports them, each 4 MB of RAM that does not hold
+   kernel text, which must stay read-only, is mapped with a single
+   large page instead of a page table, and all kernel mappings
+   are global.  Large pages save page tables and TLB entries, and
+   global ones survive the CR3 load of every process switch. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = small_pages ? 0 : cpu_features ();
+  bool large = (features & CPUID_PSE) != 0;
+  uint32_t global = (features & CPUID_PGE) != 0 ? PTE_G : 0;
+  uint32_t cr4;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -171,15 +244,33 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (large && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true) | global;
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
+  /* Large pages must be enabled before any PDE that uses them is
+     loaded. */
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (large)
+    cr4 |= CR4_PSE;
+  if (global)
+    cr4 |= CR4_PGE;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -247,6 +338,14 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-stripe"))
+        stripe_bdev_names = value;
+      else if (!strcmp (name, "-stripe-chunk"))
+        stripe_chunk_sectors = atoi (value);
+      else if (!strcmp (name, "-latency"))
+        latency_bdev_names = value;
+      else if (!strcmp (name, "-latency-model"))
+        set_latency_model (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -256,9 +355,19 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-small-pages"))
+        small_pages = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
+      else if (!strcmp (name, "-fault-stats"))
+        print_fault_stats = true;
+      else if (!strcmp (name, "-swap-cache"))
+        swap_cache_pages = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -291,6 +400,15 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef FILESYS
+/* Prints detailed block device statistics. */
+static void
+print_block_stats (char **argv UNUSED)
+{
+  block_dump_stats ();
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -314,6 +432,7 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"blkstats", 1, print_block_stats},
 #endif
       {NULL, 0, NULL},
     };
@@ -363,6 +482,7 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
+          "  blkstats           Print block device statistics.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -375,11 +495,26 @@ usage (void)
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
+          "                     BDEV may be ram:SIZE for a SIZE kB RAM disk;\n"
+          "                     a RAM file system device needs -f.\n"
+          "  -stripe=BDEV,...   Stripe file system across BDEVs as md0.\n"
+          "  -stripe-chunk=N    Use N-sector stripe chunks (default 8).\n"
+          "  -latency=BDEV,...  Add modeled disk latency to BDEVs.\n"
+          "  -latency-model=SEEK,RPM,RATE  Model full-stroke seek of SEEK ms,\n"
+          "                     RPM spindle speed, RATE MB/s transfer rate\n"
+          "                     (default 15,7200,50).\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -small-pages       Map kernel memory with 4 kB pages, not global.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages (default 2048).\n"
+          "  -fault-stats       Print page fault statistics as processes exit.\n"
+          "  -swap-cache=COUNT  Compress up to COUNT pages of swap in memory\n"
+          "                     (default 64, 0 to disable).\n"
 #endif
           );
   shutdown_power_off ();
@@ -390,23 +525,95 @@ usage (void)
 static void
 locate_block_devices (void)
 {
+  if (stripe_bdev_names != NULL)
+    create_stripe ();
   locate_block_device (BLOCK_FILESYS, filesys_bdev_name);
   locate_block_device (BLOCK_SCRATCH, scratch_bdev_name);
 #ifdef VM
   locate_block_device (BLOCK_SWAP, swap_bdev_name);
 #endif
+  if (latency_bdev_names != NULL)
+    add_latency ();
+}
+
+/* Parses SPEC, in the form SEEK,RPM,RATE, into latency_model. */
+static void
+set_latency_model (char *spec)
+{
+  char *seek, *rpm, *rate, *save_ptr;
+
+  seek = strtok_r (spec, ",", &save_ptr);
+  rpm = strtok_r (NULL, ",", &save_ptr);
+  rate = strtok_r (NULL, ",", &save_ptr);
+  if (seek == NULL || rpm == NULL || rate == NULL
+      || atoi (rpm) <= 0 || atoi (rate) <= 0)
+    PANIC ("-latency-model needs SEEK,RPM,RATE with positive RPM, RATE");
+
+  latency_model.seek_ms = atoi (seek);
+  latency_model.rpm = atoi (rpm);
+  latency_model.mb_per_s = atoi (rate);
+}
+
+/* Stacks the latency model on top of each block device named in
+   -latency.  This is done after all devices, including RAM disks
+   and stripe sets, have been created, so any of them may be
+   named.  Partitions and stripe sets built on a slowed device
+   are slowed too. */
+static void
+add_latency (void)
+{
+  char *name, *save_ptr;
+
+  for (name = strtok_r (latency_bdev_names, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      struct block *block = block_get_by_name (name);
+      if (block == NULL)
+        PANIC ("No such block device \"%s\"", name);
+      latency_attach (block, &latency_model);
+    }
+}
+
+/* Combines the block devices named in -stripe into a striped
+   block device "md0" and, unless -filesys says otherwise, uses
+   it as the file system device. */
+static void
+create_stripe (void)
+{
+  struct block *members[STRIPE_MAX_MEMBERS];
+  size_t member_cnt = 0;
+  char *name, *save_ptr;
+
+  for (name = strtok_r (stripe_bdev_names, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      if (member_cnt >= STRIPE_MAX_MEMBERS)
+        PANIC ("Too many devices in -stripe");
+      members[member_cnt] = block_get_by_name (name);
+      if (members[member_cnt] == NULL)
+        PANIC ("No such block device \"%s\"", name);
+      member_cnt++;
+    }
+
+  stripe_create ("md0", BLOCK_FILESYS, members, member_cnt,
+                 stripe_chunk_sectors);
+  if (filesys_bdev_name == NULL)
+    filesys_bdev_name = "md0";
 }
 
 /* Figures out what block device to use for the given ROLE: the
    block device with the given NAME, if NAME is non-null,
    otherwise the first block device in probe order of type
-   ROLE. */
+   ROLE.  If NAME has the form "ram:SIZE", creates a new RAM disk
+   of SIZE kB for ROLE instead. */
 static void
 locate_block_device (enum block_type role, const char *name)
 {
   struct block *block = NULL;
 
-  if (name != NULL)
+  if (name != NULL && strnlen (name, 4) == 4 && !memcmp (name, "ram:", 4))
+    block = ramdisk_create (role, atoi (name + 4));
+  else if (name != NULL)
     {
       block = block_get_by_name (name);
       if (block == NULL)
@@ -113,6 +113,58 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
+/* Obtains PAGE_CNT free pages, which need not be contiguous, and
+   stores their kernel virtual addresses in PAGES.  FLAGS is
+   interpreted as for palloc_get_multiple().  The pool lock is
+   acquired once for all of them, and if a run of PAGE_CNT free
+   pages exists they are taken with a single bitmap update.
+   Returns true if successful, false if too few pages are
+   available, in which case none are allocated. */
+bool
+palloc_get_pages (enum palloc_flags flags, void *pages[], size_t page_cnt)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t page_idx;
+  size_t i;
+
+  if (page_cnt == 0)
+    return true;
+
+  lock_acquire (&pool->lock);
+  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  if (page_idx != BITMAP_ERROR)
+    {
+      for (i = 0; i < page_cnt; i++)
+        pages[i] = pool->base + PGSIZE * (page_idx + i);
+    }
+  else if (bitmap_count (pool->used_map, 0, bitmap_size (pool->used_map),
+                         false) >= page_cnt)
+    {
+      /* No run long enough, but enough scattered pages. */
+      page_idx = 0;
+      for (i = 0; i < page_cnt; i++)
+        {
+          page_idx = bitmap_scan_and_flip (pool->used_map, page_idx, 1,
+                                           false);
+          ASSERT (page_idx != BITMAP_ERROR);
+          pages[i] = pool->base + PGSIZE * page_idx;
+        }
+    }
+  else
+    {
+      lock_release (&pool->lock);
+      if (flags & PAL_ASSERT)
+        PANIC ("palloc_get: out of pages");
+      return false;
+    }
+  lock_release (&pool->lock);
+
+  if (flags & PAL_ZERO)
+    for (i = 0; i < page_cnt; i++)
+      memset (pages[i], 0, PGSIZE);
+  return true;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) 
@@ -141,6 +193,54 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
 }
 
+/* Frees the PAGE_CNT pages whose addresses are in PAGES, which
+   need not be contiguous or even from the same pool.  Runs of
+   pages that are adjacent in PAGES and in memory are freed with
+   a single bitmap update, and each pool's lock is acquired once
+   per change of pool rather than once per page. */
+void
+palloc_free_pages (void *pages[], size_t page_cnt)
+{
+  struct pool *locked = NULL;
+  size_t i, run;
+
+  for (i = 0; i < page_cnt; i += run)
+    {
+      struct pool *pool;
+      size_t page_idx;
+
+      ASSERT (pg_ofs (pages[i]) == 0);
+      if (page_from_pool (&kernel_pool, pages[i]))
+        pool = &kernel_pool;
+      else if (page_from_pool (&user_pool, pages[i]))
+        pool = &user_pool;
+      else
+        NOT_REACHED ();
+
+      for (run = 1; i + run < page_cnt; run++)
+        if (pages[i + run] != (uint8_t *) pages[i] + run * PGSIZE
+            || !page_from_pool (pool, pages[i + run]))
+          break;
+
+#ifndef NDEBUG
+      memset (pages[i], 0xcc, PGSIZE * run);
+#endif
+
+      if (pool != locked)
+        {
+          if (locked != NULL)
+            lock_release (&locked->lock);
+          lock_acquire (&pool->lock);
+          locked = pool;
+        }
+      page_idx = pg_no (pages[i]) - pg_no (pool->base);
+      ASSERT (bitmap_all (pool->used_map, page_idx, run));
+      bitmap_set_multiple (pool->used_map, page_idx, run, false);
+    }
+  if (locked != NULL)
+    lock_release (&locked->lock);
+}
+
 /* Frees the page at PAGE. */
 void
 palloc_free_page (void *page) 
@@ -7,6 +7,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
@@ -37,6 +38,14 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Exit records of all threads that are running or that their
+   parents may still wait for, indexed by tid, so that waiting
+   for a child takes constant time however many threads there
+   are. */
+static struct hash tid_table;
+static struct lock tid_table_lock;      /* Protects tid_table and
+                                           exit record references. */
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -70,6 +79,8 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static hash_hash_func exit_record_hash;
+static hash_less_func exit_record_less;
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -107,6 +118,11 @@ void
 thread_start (void) 
 {
  //   ASSERT(false);
+  /* Now that malloc() works, set up the tid table. */
+  lock_init (&tid_table_lock);
+  if (!hash_init (&tid_table, exit_record_hash, exit_record_less, NULL))
+    PANIC ("out of memory allocating tid table");
+
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
@@ -172,20 +188,36 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  struct exit_record *r;
   tid_t tid;
   enum intr_level old_level;
 
   ASSERT (function != NULL);
 
-  /* Allocate thread. */
+  /* Allocate thread, and a record of its exit for us. */
+  r = malloc (sizeof *r);
+  if (r == NULL)
+    return TID_ERROR;
   t = palloc_get_page (PAL_ZERO);
   if (t == NULL)
-    return TID_ERROR;
+    {
+      free (r);
+      return TID_ERROR;
+    }
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
 
+  r->tid = tid;
+  r->parent_tid = thread_tid ();
+  r->status = -1;
+  sema_init (&r->dead, 0);
+  r->ref_cnt = 2;
+  lock_acquire (&tid_table_lock);
+  hash_insert (&tid_table, &r->hash_elem);
+  lock_release (&tid_table_lock);
+
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
      member cannot be observed. */
@@ -206,7 +238,8 @@ thread_create (const char *name, int priority,
   sf->ebp = 0;
 
   t->parent = thread_current();
-  list_push_back(&(thread_current()->child_list), &t->childelem);
+  list_push_back (&thread_current ()->children, &r->elem);
+  t->exit_record = r;
 
   intr_set_level (old_level);
 
@@ -293,22 +326,106 @@ thread_tid (void)
 void
 thread_exit (void) 
 {
+  struct thread *cur = thread_current ();
+
   ASSERT (!intr_context ());
 
 #ifdef USERPROG
   process_exit ();
 #endif
 
+  /* Leave our exit status for our parent, and drop the records
+     of our children, which no one can wait for any longer. */
+  if (cur->exit_record != NULL)
+    {
+      cur->exit_record->status = cur->exit_status;
+      sema_up (&cur->exit_record->dead);
+      thread_release_exit_record (cur->exit_record);
+    }
+  while (!list_empty (&cur->children))
+    {
+      struct exit_record *r = list_entry (list_pop_front (&cur->children),
+                                          struct exit_record, elem);
+      r->parent_tid = TID_ERROR;
+      thread_release_exit_record (r);
+    }
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
-  list_remove (&thread_current()->allelem);
-  thread_current ()->status = THREAD_DYING;
+  list_remove (&cur->allelem);
+  cur->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
 }
 
+/* Returns the exit record of the running thread's child TID, if
+   it has not been waited for yet, and removes it from the running
+   thread's children so that it cannot be waited for again.
+   Returns a null pointer if TID is not such a child.  The caller
+   must release the record with thread_release_exit_record(). */
+struct exit_record *
+thread_take_child (tid_t tid)
+{
+  struct exit_record key;
+  struct exit_record *r = NULL;
+  struct hash_elem *e;
+
+  key.tid = tid;
+  lock_acquire (&tid_table_lock);
+  e = hash_find (&tid_table, &key.hash_elem);
+  if (e != NULL)
+    {
+      r = hash_entry (e, struct exit_record, hash_elem);
+      if (r->parent_tid == thread_tid ())
+        {
+          r->parent_tid = TID_ERROR;
+          list_remove (&r->elem);
+        }
+      else
+        r = NULL;
+    }
+  lock_release (&tid_table_lock);
+  return r;
+}
+
+/* Drops a reference to exit record R, freeing it if it was the
+   last one.  Called once by the thread that R describes, when it
+   exits, and once by its parent, when it waits for the thread or
+   exits itself. */
+void
+thread_release_exit_record (struct exit_record *r)
+{
+  bool last;
+
+  lock_acquire (&tid_table_lock);
+  last = --r->ref_cnt == 0;
+  if (last)
+    hash_delete (&tid_table, &r->hash_elem);
+  lock_release (&tid_table_lock);
+
+  if (last)
+    free (r);
+}
+
+/* Returns a hash of exit record E's tid. */
+static unsigned
+exit_record_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct exit_record *r = hash_entry (e, struct exit_record, hash_elem);
+  return hash_int (r->tid);
+}
+
+/* Returns true if exit record A's tid is less than B's. */
+static bool
+exit_record_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED)
+{
+  return (hash_entry (a, struct exit_record, hash_elem)->tid
+          < hash_entry (b, struct exit_record, hash_elem)->tid);
+}
+
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
 void
@@ -473,10 +590,11 @@ init_thread (struct thread *t, const char *name, int priority)
   // otis driving
   t->child_load_success = false;
   t->parent = NULL; 
-  list_init (&(t->child_list));
-  sema_init (&(t->waiting), 0);
-  sema_init (&(t->reaped), 0);
+  list_init (&t->children);
   sema_init (&(t->exec_sema), 0);
+#ifdef VM
+  list_init (&t->mappings);
+#endif
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
@@ -2,8 +2,10 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
+#include "devices/block.h"
 #include "threads/synch.h"
 
 /* States in a thread's life cycle. */
@@ -25,6 +27,9 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Maximum number of shared libraries in a process. */
+#define LIB_MAX 4
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -77,6 +82,24 @@ typedef int tid_t;
    value, triggering the assertion.  (So don't add elements below 
    THREAD_MAGIC.)
 */
+/* A thread's exit status, kept for its parent to collect with
+   process_wait() after the thread itself is gone, so that a dead
+   child does not hold on to its thread or its memory.  The
+   parent and the child each hold a reference, and whichever lets
+   go last frees it.  Until then, it can be found by tid in a
+   hash table. */
+struct exit_record
+  {
+    struct list_elem elem;              /* Element in parent's children. */
+    struct hash_elem hash_elem;         /* Element in tid table. */
+    tid_t tid;                          /* Child's thread identifier. */
+    tid_t parent_tid;                   /* Parent that may wait for it,
+                                           or TID_ERROR if none. */
+    int status;                         /* Child's exit status. */
+    struct semaphore dead;              /* Upped when the child exits. */
+    int ref_cnt;                        /* Number of references. */
+  };
+
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
    semaphore wait list (synch.c).  It can be used these two ways
@@ -94,16 +117,17 @@ struct thread
     struct list_elem allelem;           /* List element for all threads list. */
 
     //ryan driving
-    struct list child_list;             /* List of children of thread */
-    struct list_elem childelem;         /* List element for child_list. */
+    struct list children;               /* Exit records of children. */
+    struct exit_record *exit_record;    /* Own exit record, or null. */
     int exit_status;
-    struct semaphore waiting;
-    struct semaphore reaped;
     struct semaphore exec_sema;
     struct file* file;
+    struct file *libs[LIB_MAX];         /* Shared libraries, kept open. */
+    int lib_cnt;                        /* Number of LIBS. */
     struct thread* parent;              // parent of thread
     bool child_load_success;            // checks for successful load of child
     struct dir* current_dir;            // current word directory of thread
+    enum block_caller block_caller;     /* Block I/O attribution. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
@@ -112,6 +136,21 @@ struct thread
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 #endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+    void *user_esp;                     /* User stack pointer at entry
+                                           to the kernel. */
+    unsigned fault_cnt;                 /* Page faults handled. */
+    unsigned file_fault_cnt;            /* Faults that read a file. */
+    unsigned around_cnt;                /* Pages mapped around faults. */
+    unsigned around_window;             /* Pages to map around next. */
+    void *around_next;                  /* Next fault if sequential. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+#endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -139,6 +178,8 @@ tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
+struct exit_record *thread_take_child (tid_t);
+void thread_release_exit_record (struct exit_record *);
 void thread_yield (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
@@ -4,6 +4,11 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/usercopy.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -150,6 +155,25 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* Bring in the page if it belongs to the process, growing the
+     stack if need be, or copy it if the process is writing a page
+     it shares copy-on-write.  This also covers the kernel touching
+     user memory on a process's behalf, e.g. while reading system
+     call arguments, in which case the user stack pointer was
+     saved on entry to the system call. */
+  if (user)
+    thread_current ()->user_esp = f->esp;
+  if ((not_present || write) && is_user_vaddr (fault_addr)
+      && page_in (fault_addr, write))
+    return;
+#endif
+
+  /* The kernel touched user memory that is not there while
+     copying to or from it.  Let the copy fail. */
+  if (!user && usercopy_fixup (f))
+    return;
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
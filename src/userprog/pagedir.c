@@ -7,6 +7,7 @@
 #include "threads/palloc.h"
 
 static uint32_t *active_pd (void);
+static void load_pagedir (uint32_t *);
 static void invalidate_pagedir (uint32_t *);
 
 /* Creates a new page directory that has mappings for kernel
@@ -22,17 +23,28 @@ pagedir_create (void)
   return pd;
 }
 
+/* Number of pages that pagedir_destroy() frees at once. */
+#define FREE_BATCH 32
+
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  The pages are freed in batches, so that runs of
+   them that are contiguous in memory cost one bitmap update. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
+  void *batch[FREE_BATCH];
+  size_t batch_cnt = 0;
   uint32_t *pde;
 
   if (pd == NULL)
     return;
 
+  /* A kernel thread keeps whatever page directory is loaded, so
+     the thread destroying PD may be running on it. */
   ASSERT (pd != init_page_dir);
+  if (active_pd () == pd)
+    load_pagedir (init_page_dir);
+
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
     if (*pde & PTE_P) 
       {
@@ -41,9 +53,17 @@ pagedir_destroy (uint32_t *pd)
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
           if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
+            {
+              batch[batch_cnt++] = pte_get_page (*pte);
+              if (batch_cnt == FREE_BATCH)
+                {
+                  palloc_free_pages (batch, batch_cnt);
+                  batch_cnt = 0;
+                }
+            }
         palloc_free_page (pt);
       }
+  palloc_free_pages (batch, batch_cnt);
   palloc_free_page (pd);
 }
 
@@ -118,6 +138,40 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Maps the CNT consecutive user virtual pages starting at UPAGE
+   in PD to the frames whose kernel virtual addresses are in
+   KPAGES, as pagedir_set_page() does for one page.  Returns true
+   if successful.  Returns false, mapping nothing, if memory for
+   a page table cannot be allocated or if any of the pages is
+   already mapped. */
+bool
+pagedir_set_pages (uint32_t *pd, void *upage, void *kpages[], size_t cnt,
+                   bool writable)
+{
+  uint8_t *vaddr;
+  size_t i;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (pd != init_page_dir);
+
+  /* Create the page tables first, so that failure leaves
+     nothing half done. */
+  for (i = 0, vaddr = upage; i < cnt; i++, vaddr += PGSIZE)
+    {
+      uint32_t *pte = lookup_page (pd, vaddr, true);
+      if (pte == NULL || (*pte & PTE_P) != 0)
+        return false;
+    }
+
+  for (i = 0, vaddr = upage; i < cnt; i++, vaddr += PGSIZE)
+    {
+      ASSERT (pg_ofs (kpages[i]) == 0);
+      ASSERT (vtop (kpages[i]) >> PTSHIFT < init_ram_pages);
+      *lookup_page (pd, vaddr, false) = pte_create_user (kpages[i], writable);
+    }
+  return true;
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -156,6 +210,53 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Marks the CNT consecutive user virtual pages starting at UPAGE
+   "not present" in PD, as pagedir_clear_page() does for one
+   page, but flushes the TLB only once for all of them.  Ranges
+   without a page table are skipped a page table at a time, so
+   clearing a large, sparse range is cheap. */
+void
+pagedir_clear_pages (uint32_t *pd, void *upage, size_t cnt)
+{
+  uint8_t *vaddr = upage;
+  uint8_t *end = vaddr + cnt * PGSIZE;
+  bool cleared = false;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (end >= vaddr && end <= (uint8_t *) PHYS_BASE);
+
+  while (vaddr < end)
+    {
+      uint32_t *pde = pd + pd_no (vaddr);
+      uint8_t *next = (uint8_t *) ((uintptr_t) (pd_no (vaddr) + 1) << PDSHIFT);
+      if (next > end)
+        next = end;
+
+      if (*pde & PTE_P)
+        {
+          uint32_t *pt = pde_get_pt (*pde);
+          for (; vaddr < next; vaddr += PGSIZE)
+            if (pt[pt_no (vaddr)] & PTE_P)
+              {
+                pt[pt_no (vaddr)] &= ~PTE_P;
+                cleared = true;
+              }
+        }
+      vaddr = next;
+    }
+  if (cleared)
+    invalidate_pagedir (pd);
+}
+
+/* Returns true if virtual page VPAGE is mapped in PD and
+   writable. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -215,13 +316,22 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
 }
 
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register, unless it is already loaded, in which case the TLB
+   is left alone. */
 void
 pagedir_activate (uint32_t *pd) 
 {
   if (pd == NULL)
     pd = init_page_dir;
+  if (active_pd () != pd)
+    load_pagedir (pd);
+}
 
+/* Loads page directory PD into the CPU's page directory base
+   register, which also flushes the TLB. */
+static void
+load_pagedir (uint32_t *pd) 
+{
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -256,8 +366,8 @@ invalidate_pagedir (uint32_t *pd)
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
+      /* Re-loading PD clears the TLB.  See [IA32-v3a] 3.12
          "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      load_pagedir (pd);
     } 
 }
@@ -1,5 +1,6 @@
 #include "userprog/process.h"
 #include <debug.h>
+#include <hash.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
@@ -9,23 +10,66 @@
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
 #include "userprog/syscall.h"
+#include "userprog/usercopy.h"
+#include "devices/block.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 struct list all_list;
 
 static bool no_file;
 
-static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+/* An exited process's page directory, waiting to be destroyed
+   by the reaper thread. */
+struct corpse
+  {
+    struct list_elem elem;      /* Element in corpses. */
+    uint32_t *pagedir;          /* Page directory to destroy. */
+  };
+
+static struct list corpses;     /* Corpses waiting for the reaper. */
+static struct lock corpse_lock; /* Protects corpses. */
+static struct semaphore corpse_sema; /* Upped for each corpse. */
 
+static thread_func reaper;
+
+static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
+static bool load (const char *cmdline, struct intr_frame *);
+#ifdef VM
+static bool is_checkpoint (struct file *);
+static bool restore_checkpoint (struct file *, struct intr_frame *);
+#endif
+static void image_init (void);
+
+/* Starts the reaper thread, which destroys the page directories
+   of processes that have exited, and initializes the cache of
+   executable images. */
+void
+process_init (void)
+{
+  image_init ();
+  list_init (&corpses);
+  lock_init (&corpse_lock);
+  sema_init (&corpse_sema, 0);
+  thread_create ("reaper", PRI_DEFAULT, reaper, NULL);
+}
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -96,8 +140,12 @@ start_process (void *file_name_)
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
   
-  success = load (file_name, &if_.eip, &if_.esp);
+  success = load (file_name, &if_);
 
+  /* The parent does not learn our tid if load failed, so it
+     cannot wait for us. */
+  if (!success)
+    thread_current()->exit_record->parent_tid = TID_ERROR;
   thread_current()->parent->child_load_success = success;
   sema_up(&(thread_current()->parent->exec_sema));
 
@@ -106,8 +154,6 @@ start_process (void *file_name_)
 
   // printf("start tid: %d\n", thread_current()->tid);
   if (!success){
-    thread_current()->tid = -1;
-    list_remove(&(thread_current ()->childelem));
     thread_exit ();
   }
 
@@ -121,62 +167,351 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
-/* Waits for thread TID to die and returns its exit status.  If
-   it was terminated by the kernel (i.e. killed due to an
-   exception), returns -1.  If TID is invalid or if it was not a
-   child of the calling process, or if process_wait() has already
-   been successfully called for the given TID, returns -1
-   immediately, without waiting.
+#ifdef VM
+/* Starts a new process that is a copy of the running one, which
+   is in the system call whose interrupt frame is IF.  The child's
+   address space is copied lazily, copy-on-write.  File
+   descriptors are global, so the child can read, write, and
+   seek the files its parent has open, sharing their positions,
+   but they stay the parent's: the child cannot close or map
+   them, nor save them in a checkpoint.  Returns the child's
+   thread id in the parent, or TID_ERROR if the child cannot be
+   created.  The child returns 0 from the same system call. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct thread *cur = thread_current ();
+  struct intr_frame *if_copy;
+  tid_t tid;
+
+  if (cur->pages == NULL)
+    return TID_ERROR;
+
+  /* The child copies the frame onto its own stack. */
+  if_copy = palloc_get_page (0);
+  if (if_copy == NULL)
+    return TID_ERROR;
+  *if_copy = *if_;
 
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, if_copy);
+  if (tid == TID_ERROR)
+    {
+      palloc_free_page (if_copy);
+      return TID_ERROR;
+    }
+
+  /* Wait for the child to copy our address space, which must not
+     change in the meantime. */
+  sema_down (&cur->exec_sema);
+  if (!cur->child_load_success)
+    return TID_ERROR;
+  return tid;
+}
 
-//ryan driving
-struct thread* list_contains_pid(struct list *l, tid_t id, int option)
+/* A thread function that copies its parent's address space and
+   returns to user mode from the parent's fork() system call. */
+static void
+start_fork (void *if_copy)
 {
-  /*
-  1 = childelem
-  2 = allelem
-  */
-  if (list_empty(l)) return NULL;
-  struct list_elem *e;
+  struct thread *t = thread_current ();
+  struct thread *parent = t->parent;
+  struct intr_frame if_ = *(struct intr_frame *) if_copy;
+  bool success = false;
 
-  for (e = list_rbegin (l); e != list_rend (l); e = list_prev (e))
-  {
-    //gavin driving
-    struct thread *t = NULL;
-    if(option == 1)
+  palloc_free_page (if_copy);
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto done;
+  process_activate ();
+  if (!page_table_create ())
+    goto done;
+  if (parent->file != NULL)
     {
-      t = list_entry (e, struct thread, childelem);
+      t->file = file_reopen (parent->file);
+      if (t->file == NULL)
+        goto done;
+      file_deny_write (t->file);
     }
-    else if(option == 2)
+  for (; t->lib_cnt < parent->lib_cnt; t->lib_cnt++)
     {
-      t = list_entry (e, struct thread, allelem);
+      struct file *lib = file_reopen (parent->libs[t->lib_cnt]);
+      if (lib == NULL)
+        goto done;
+      file_deny_write (lib);
+      t->libs[t->lib_cnt] = lib;
     }
-    if(t->tid == id)
+  if (parent->current_dir != NULL)
+    t->current_dir = dir_reopen (parent->current_dir);
+  t->user_esp = parent->user_esp;
+  success = page_table_copy (parent);
+
+ done:
+  /* The parent does not learn our tid on failure, so it cannot
+     wait for us. */
+  if (!success)
+    t->exit_record->parent_tid = TID_ERROR;
+  parent->child_load_success = success;
+  sema_up (&parent->exec_sema);
+
+  if (!success)
+    thread_exit ();
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Checkpoints.
+
+   A checkpoint file holds a process's user pages, registers, and
+   open files, so that it can be resumed later.  It begins with a
+   struct ckpt_header, followed by a struct ckpt_page for each
+   saved page and a struct saved_file for each open file.  The
+   pages' contents follow, one per page-aligned block, in the same
+   order as their records.
+
+   load() recognizes a checkpoint by its magic number.  Rather
+   than reading the pages back, it backs each page by its block
+   of the checkpoint file, just as an executable's pages are
+   backed by the executable, so that each is read only when the
+   resumed process first touches it. */
+
+/* Magic number at the start of a checkpoint file. */
+#define CKPT_MAGIC "PINTCKPT"
+
+/* EFLAGS bits that a checkpoint may set: the arithmetic flags
+   and the direction flag. */
+#define CKPT_EFLAGS 0x00000cd5
+
+/* Checkpoint file header. */
+struct ckpt_header
+  {
+    char magic[8];              /* CKPT_MAGIC, without the null. */
+    uint32_t page_cnt;          /* Number of pages saved. */
+    uint32_t file_cnt;          /* Number of open files saved. */
+    uint32_t data_ofs;          /* Offset of first page's contents. */
+    uint32_t edi, esi, ebp, ebx; /* User registers. */
+    uint32_t edx, ecx, eax;
+    uint32_t eip, eflags, esp;
+  };
+
+/* A saved page. */
+struct ckpt_page
+  {
+    uint32_t upage;             /* User virtual address. */
+    uint32_t writable;          /* Writable by the process? */
+  };
+
+/* Progress in writing a checkpoint. */
+struct ckpt_writer
+  {
+    struct file *file;          /* Checkpoint file. */
+    size_t page_idx;            /* Pages written so far. */
+    off_t data_ofs;             /* Offset of first page's contents. */
+  };
+
+/* page_table_walk() function that counts pages in *AUX, a
+   size_t. */
+static bool
+count_page (struct page *p UNUSED, void *aux)
+{
+  size_t *page_cnt = aux;
+  (*page_cnt)++;
+  return true;
+}
+
+/* page_table_walk() function that writes P's record and contents
+   to the checkpoint that AUX, a struct ckpt_writer, is writing. */
+static bool
+save_page (struct page *p, void *aux)
+{
+  struct ckpt_writer *w = aux;
+  struct ckpt_page rec;
+  off_t rec_ofs = sizeof (struct ckpt_header) + w->page_idx * sizeof rec;
+  off_t ofs = w->data_ofs + w->page_idx * PGSIZE;
+  bool success;
+
+  rec.upage = (uint32_t) p->upage;
+  rec.writable = p->writable;
+  if (file_write_at (w->file, &rec, sizeof rec, rec_ofs) != sizeof rec)
+    return false;
+
+  /* Write the page straight from user memory, keeping it in its
+     frame meanwhile. */
+  if (!page_lock (p->upage, false))
+    return false;
+  success = file_write_at (w->file, p->upage, PGSIZE, ofs) == PGSIZE;
+  page_unlock (p->upage);
+
+  w->page_idx++;
+  return success;
+}
+
+/* Saves the running process, whose user registers are in IF_,
+   to a new file named FILE_NAME, along with FILE_CNT open FILES.
+   A process loaded from the checkpoint resumes with EAX set to 1.
+   The caller must hold the file system lock.  Returns true if
+   successful, false otherwise. */
+bool
+process_checkpoint (const char *file_name, const struct intr_frame *if_,
+                    const struct saved_file files[], size_t file_cnt)
+{
+  struct ckpt_header h;
+  struct ckpt_writer w;
+  size_t page_cnt = 0;
+  off_t files_ofs, files_size;
+  bool success;
+
+  if (thread_current ()->pages == NULL)
+    return false;
+  page_table_walk (count_page, &page_cnt);
+
+  files_ofs = sizeof h + page_cnt * sizeof (struct ckpt_page);
+  files_size = file_cnt * sizeof *files;
+
+  memset (&h, 0, sizeof h);
+  memcpy (h.magic, CKPT_MAGIC, sizeof h.magic);
+  h.page_cnt = page_cnt;
+  h.file_cnt = file_cnt;
+  h.data_ofs = ROUND_UP (files_ofs + files_size, PGSIZE);
+  h.edi = if_->edi;
+  h.esi = if_->esi;
+  h.ebp = if_->ebp;
+  h.ebx = if_->ebx;
+  h.edx = if_->edx;
+  h.ecx = if_->ecx;
+  h.eax = 1;
+  h.eip = (uint32_t) if_->eip;
+  h.eflags = if_->eflags;
+  h.esp = (uint32_t) if_->esp;
+
+  if (!filesys_create (file_name, h.data_ofs + page_cnt * PGSIZE))
+    return false;
+  w.file = filesys_open (file_name);
+  if (w.file == NULL)
     {
-      return t;
+      filesys_remove (file_name);
+      return false;
     }
-  }
-  return NULL;
+  w.page_idx = 0;
+  w.data_ofs = h.data_ofs;
+
+  success = (file_write_at (w.file, &h, sizeof h, 0) == sizeof h
+             && page_table_walk (save_page, &w)
+             && file_write_at (w.file, files, files_size,
+                               files_ofs) == files_size);
+  file_close (w.file);
+  if (!success)
+    filesys_remove (file_name);
+  return success;
+}
+
+/* Returns true if FILE starts with a checkpoint's magic
+   number. */
+static bool
+is_checkpoint (struct file *file)
+{
+  char magic[sizeof CKPT_MAGIC - 1];
+
+  return (file_read_at (file, magic, sizeof magic, 0) == sizeof magic
+          && !memcmp (magic, CKPT_MAGIC, sizeof magic));
+}
+
+/* Resumes the process saved in checkpoint FILE in the running
+   process, storing its user registers in IF_.  Its pages are
+   read from FILE on demand, so FILE must stay open.  Returns
+   true if successful, false otherwise. */
+static bool
+restore_checkpoint (struct file *file, struct intr_frame *if_)
+{
+  struct ckpt_header h;
+  struct saved_file *files;
+  off_t length = file_length (file);
+  off_t files_ofs;
+  size_t i;
+  bool success;
+
+  /* The checkpoint is an ordinary file that its owner can
+     rewrite, so check everything in it.  The records and pages
+     must all lie within FILE and the registers must point into
+     user memory. */
+  if (file_read_at (file, &h, sizeof h, 0) != sizeof h
+      || !is_user_vaddr ((void *) h.eip)
+      || !is_user_vaddr ((void *) h.esp)
+      || h.data_ofs % PGSIZE != 0
+      || h.data_ofs < sizeof h
+      || h.data_ofs > (uint32_t) length
+      || h.page_cnt > (length - h.data_ofs) / PGSIZE
+      || h.page_cnt > (h.data_ofs - sizeof h) / sizeof (struct ckpt_page)
+      || h.file_cnt > PGSIZE / sizeof *files)
+    return false;
+  files_ofs = sizeof h + h.page_cnt * sizeof (struct ckpt_page);
+  if (files_ofs + h.file_cnt * sizeof *files > h.data_ofs)
+    return false;
+
+  for (i = 0; i < h.page_cnt; i++)
+    {
+      struct ckpt_page rec;
+      struct page *p;
+
+      if (file_read_at (file, &rec, sizeof rec,
+                        sizeof h + i * sizeof rec) != sizeof rec
+          || pg_ofs ((void *) rec.upage) != 0
+          || rec.upage < PGSIZE
+          || !is_user_vaddr ((void *) rec.upage))
+        return false;
+      p = page_allocate ((void *) rec.upage, rec.writable != 0);
+      if (p == NULL)
+        return false;
+      p->file = file;
+      p->file_ofs = h.data_ofs + i * PGSIZE;
+      p->read_bytes = PGSIZE;
+    }
+
+  files = palloc_get_page (0);
+  if (files == NULL)
+    return false;
+  success = (file_read_at (file, files, h.file_cnt * sizeof *files,
+                           files_ofs)
+             == (off_t) (h.file_cnt * sizeof *files)
+             && syscall_restore_files (files, h.file_cnt));
+  palloc_free_page (files);
+  if (!success)
+    return false;
+
+  if_->edi = h.edi;
+  if_->esi = h.esi;
+  if_->ebp = h.ebp;
+  if_->ebx = h.ebx;
+  if_->edx = h.edx;
+  if_->ecx = h.ecx;
+  if_->eax = h.eax;
+  if_->eip = (void (*) (void)) h.eip;
+  if_->eflags = FLAG_IF | FLAG_MBS | (h.eflags & CKPT_EFLAGS);
+  if_->esp = (void *) h.esp;
+  return true;
 }
+#endif
 
+/* Waits for thread TID to die and returns its exit status.  If
+   it was terminated by the kernel (i.e. killed due to an
+   exception), returns -1.  If TID is invalid or if it was not a
+   child of the calling process, or if process_wait() has already
+   been successfully called for the given TID, returns -1
+   immediately, without waiting. */
 int
 process_wait (tid_t child_tid)
 {
-  struct thread *parent = thread_current();
-  struct thread *child = list_contains_pid(&(parent->child_list), child_tid, 1);
-
-  if (child == NULL)
-  {
+  /* A child that has exited is gone already, but left its exit
+     status behind in its record. */
+  struct exit_record *r = thread_take_child (child_tid);
+  if (r == NULL)
     return -1;
-  }
-  sema_down(&(parent->waiting)); //Thread will continue when dying
-  //Reap child that we waited on.
-  int exit_status =child->exit_status;
-  list_remove(&(child->childelem));
-  sema_up(&(parent->reaped));
 
+  sema_down (&r->dead);
+  int exit_status = r->status;
+  thread_release_exit_record (r);
   return exit_status;
 }
 
@@ -193,38 +528,71 @@ process_exit (void)
      to the kernel-only page directory. */
 
   // ASSERT(false);
+#ifdef VM
+  /* Write back memory-mapped files, then release the process's
+     pages while the executable they may be backed by is still
+     open. */
+  page_print_stats ();
+  mmap_unmap_all ();
+  page_table_destroy ();
+#endif
   if (cur->file != NULL) {
     file_close(cur->file);
   }
-
-  struct list_elem *e;
-
-  for (e = list_rbegin (&cur->child_list); e != list_rend (&cur->child_list); e = list_prev (e))
-  {
-    //gavin driving
-    struct thread* t = list_entry(e, struct thread, childelem);
-    t->parent = NULL;
-  }
-
-  if(cur->parent != NULL) {
-    sema_up(&(cur->parent->waiting));
-    sema_down(&(cur->parent->reaped));
-  }
-
+  while (cur->lib_cnt > 0)
+    file_close (cur->libs[--cur->lib_cnt]);
+
+  /* Our parent collects our exit status from our exit record
+     whenever it likes, so we need not wait for it.  Hand our
+     page directory, and without virtual memory all of our
+     memory, to the reaper to free, so that we can die at once.
+
+     We must set cur->pagedir to NULL first, so that a timer
+     interrupt can't switch back to the process page directory.
+     It may stay loaded until another process runs, but
+     pagedir_destroy() takes care of that. */
   pd = cur->pagedir;
   if (pd != NULL)
     {
-      /* Correct ordering here is crucial.  We must set
-         cur->pagedir to NULL before switching page directories,
-         so that a timer interrupt can't switch back to the
-         process page directory.  We must activate the base page
-         directory before destroying the process's page
-         directory, or our active page directory will be one
-         that's been freed (and cleared). */
+      struct corpse *c = malloc (sizeof *c);
 
       cur->pagedir = NULL;
-      pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      if (c != NULL)
+        {
+          c->pagedir = pd;
+          lock_acquire (&corpse_lock);
+          list_push_back (&corpses, &c->elem);
+          lock_release (&corpse_lock);
+          sema_up (&corpse_sema);
+        }
+      else
+        pagedir_destroy (pd);
+    }
+}
+
+/* Reaper thread.  Destroys the page directories of exited
+   processes, all that have piled up each time it runs. */
+static void
+reaper (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct list batch;
+
+      sema_down (&corpse_sema);
+      list_init (&batch);
+      lock_acquire (&corpse_lock);
+      while (!list_empty (&corpses))
+        list_push_back (&batch, list_pop_front (&corpses));
+      lock_release (&corpse_lock);
+
+      while (!list_empty (&batch))
+        {
+          struct corpse *c = list_entry (list_pop_front (&batch),
+                                         struct corpse, elem);
+          pagedir_destroy (c->pagedir);
+          free (c);
+        }
     }
 }
 
@@ -236,8 +604,15 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread, or a
+     process that has not loaded yet, has none of its own, so it
+     keeps whatever page directory is loaded: the kernel part of
+     every page directory is the same, and such a thread touches
+     only that.  Together with pagedir_activate() skipping a page
+     directory that is already loaded, this saves a TLB flush on
+     switches to and from kernel threads such as idle. */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -250,6 +625,7 @@ process_activate (void)
 /* ELF types.  See [ELF1] 1-2. */
 typedef uint32_t Elf32_Word, Elf32_Addr, Elf32_Off;
 typedef uint16_t Elf32_Half;
+typedef int32_t Elf32_Sword;
 
 /* For use with ELF types in printf(). */
 #define PE32Wx PRIx32   /* Print Elf32_Word in hexadecimal. */
@@ -292,6 +668,66 @@ struct Elf32_Phdr
     Elf32_Word p_align;
   };
 
+/* Values for e_type.  See [ELF1] 1-3. */
+#define ET_EXEC 2               /* Executable file. */
+#define ET_DYN  3               /* Shared object file. */
+
+/* Dynamic section entry.  See [ELF1] 2-9 to 2-15.
+   A PT_DYNAMIC segment holds an array of these, ending with one
+   whose d_tag is DT_NULL. */
+struct Elf32_Dyn
+  {
+    Elf32_Sword d_tag;
+    Elf32_Word  d_val;          /* Value or address, per d_tag. */
+  };
+
+/* Values for d_tag.  See [ELF1] 2-10. */
+#define DT_NULL     0           /* End of array. */
+#define DT_NEEDED   1           /* String offset of needed library. */
+#define DT_PLTRELSZ 2           /* Size of PLT relocations. */
+#define DT_HASH     4           /* Symbol hash table. */
+#define DT_STRTAB   5           /* String table. */
+#define DT_SYMTAB   6           /* Symbol table. */
+#define DT_REL      17          /* Relocations. */
+#define DT_RELSZ    18          /* Size of DT_REL relocations. */
+#define DT_PLTREL   20          /* Type of PLT relocations. */
+#define DT_TEXTREL  22          /* Relocations modify read-only text. */
+#define DT_JMPREL   23          /* PLT relocations. */
+
+/* Symbol table entry.  See [ELF1] 1-17 to 1-21. */
+struct Elf32_Sym
+  {
+    Elf32_Word    st_name;      /* String table offset of name. */
+    Elf32_Addr    st_value;
+    Elf32_Word    st_size;
+    unsigned char st_info;      /* Binding and type. */
+    unsigned char st_other;
+    Elf32_Half    st_shndx;     /* Section, or SHN_UNDEF. */
+  };
+
+#define SHN_UNDEF 0             /* Undefined symbol. */
+#define STB_LOCAL 0             /* Symbol binding: local. */
+#define STB_WEAK  2             /* Symbol binding: weak. */
+#define ELF32_ST_BIND(INFO) ((INFO) >> 4)
+
+/* Relocation entry, without addend.  See [ELF1] 1-21 to 1-23. */
+struct Elf32_Rel
+  {
+    Elf32_Addr r_offset;        /* Address to relocate. */
+    Elf32_Word r_info;          /* Symbol index and type. */
+  };
+
+#define ELF32_R_SYM(INFO) ((INFO) >> 8)
+#define ELF32_R_TYPE(INFO) ((unsigned char) (INFO))
+
+/* i386 relocation types.  See [ELF3] 2-5 to 2-7. */
+#define R_386_NONE     0        /* Nothing. */
+#define R_386_32       1        /* S + A. */
+#define R_386_PC32     2        /* S + A - P. */
+#define R_386_GLOB_DAT 6        /* S. */
+#define R_386_JMP_SLOT 7        /* S. */
+#define R_386_RELATIVE 8        /* B + A. */
+
 /* Values for p_type.  See [ELF1] 2-3. */
 #define PT_NULL    0            /* Ignore. */
 #define PT_LOAD    1            /* Loadable segment. */
@@ -307,32 +743,107 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
+/* Without virtual memory, number of pages of a segment that
+   load_segment() allocates and maps at once. */
+#define LOAD_BATCH 16
+
+/* Shared libraries are mapped one after another starting at
+   LIB_BASE, and must all fit below LIB_LIMIT. */
+#define LIB_BASE  0x40000000
+#define LIB_LIMIT 0x80000000
+
+/* A loadable segment of an executable, as load_segment() wants
+   it. */
+struct segment
+  {
+    uint32_t file_page;         /* Page-aligned offset in file. */
+    uint32_t mem_page;          /* Page-aligned user address. */
+    uint32_t read_bytes;        /* Bytes to read from file. */
+    uint32_t zero_bytes;        /* Bytes to zero after them. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* An executable's headers, parsed and checked.  Programs tend to
+   be run over and over, so the images of recently run ones are
+   cached by their inode sector, sparing each exec the header
+   reads and checks.  The pages themselves are shared through
+   vm/share.c.
+
+   The cache keeps each inode open, and notes how many times it
+   has been written, so that an image parsed from an old version
+   of the file is never used.  An image is freed once it has left
+   the cache and no load() is using it. */
+struct image
+  {
+    struct hash_elem elem;      /* Element in images. */
+    struct list_elem lru_elem;  /* Element in image_lru. */
+    block_sector_t sector;      /* Inode sector of file. */
+    struct inode *inode;        /* File's inode, kept open. */
+    unsigned write_cnt;         /* Inode's write count when parsed. */
+    int ref_cnt;                /* Number of load()s using it. */
+    bool cached;                /* In images? */
+    Elf32_Half type;            /* ET_EXEC or ET_DYN. */
+    Elf32_Addr entry;           /* Entry point. */
+    Elf32_Addr dynamic;         /* Dynamic section, or 0 if none. */
+    size_t dynamic_cnt;         /* Number of dynamic entries. */
+    uint32_t span;              /* Bytes of address space used. */
+    size_t segment_cnt;         /* Number of loadable segments. */
+    struct segment segments[];  /* Loadable segments. */
+  };
+
+/* Maximum number of images cached. */
+#define IMAGE_CACHE_SIZE 16
+
+static struct hash images;      /* Cached images. */
+static struct list image_lru;   /* Cached images, most recent first. */
+static struct lock image_lock;  /* Protects the cache. */
+static long long image_hit_cnt; /* Execs that found a cached image. */
+static long long image_miss_cnt; /* Execs that parsed the file. */
+
+static unsigned image_hash (const struct hash_elem *, void *);
+static bool image_less (const struct hash_elem *, const struct hash_elem *,
+                        void *);
+static struct image *image_get (struct file *, const char *file_name);
+static void image_put (struct image *);
+
 static bool setup_stack (void **esp,const char* file_name);
-static bool validate_segment (const struct Elf32_Phdr *, struct file *);
+static void push_arguments (void **esp, const char* file_name);
+static bool validate_segment (const struct Elf32_Phdr *, struct file *,
+                              Elf32_Addr base);
+static bool map_image (const struct image *, struct file *, uint32_t base);
+static bool link_program (struct image *, const char *file_name);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
 /* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
+   Stores the executable's entry point into IF_->eip
+   and its initial stack pointer into IF_->esp.  With virtual
+   memory, FILE_NAME may instead be a checkpoint, which is
+   resumed with all of its saved registers.
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (const char *file_name, struct intr_frame *if_) 
 {
 //  
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
+  struct image *image = NULL;
   struct file *file = NULL;
-  off_t file_ofs;
   bool success = false;
-  int i;
+  enum block_caller old_caller;
+
+  /* Charge disk reads made while loading to exec. */
+  old_caller = block_set_caller (BLOCK_CALLER_EXEC);
 
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_create ())
+    goto done;
+#endif
 
   /* Open executable file. */
   //took full file name in, tokenized to find the first argument
@@ -352,19 +863,108 @@ load (const char *file_name, void (**eip) (void), void **esp)
   //t->file = file;
   //file_deny_write(t->file);
   palloc_free_page(fn_copy);
+#ifdef VM
+  /* A checkpoint resumes where it left off. */
+  if (is_checkpoint (file))
+    {
+      success = restore_checkpoint (file, if_);
+      goto done;
+    }
+#endif
+  /* Map the executable, then any shared libraries it needs. */
+  image = image_get (file, file_name);
+  if (image == NULL)
+    goto done;
+  if (image->type != ET_EXEC)
+    {
+      printf ("load: %s: error loading executable\n", file_name);
+      goto done;
+    }
+  if (!map_image (image, file, 0))
+    goto done;
+  if (image->dynamic != 0 && !link_program (image, file_name))
+    goto done;
+
+  /* Set up stack. */
+
+  if (!setup_stack (&if_->esp,file_name))
+    goto done;
+
+  /* Start address. */
+  if_->eip = (void (*) (void)) image->entry;
+
+  success = true;
+
+ done:
+  /* We arrive here whether the load is successful or not. */
+  if (image != NULL)
+    image_put (image);
+  if(!success)
+  {
+    file_close (file);
+  }
+  else
+  {
+    t->file = file;
+    file_deny_write(t->file);
+  }
+  block_set_caller (old_caller);
+  return success;
+}
+
+/* load() helpers. */
+
+/* Initializes the cache of executable images. */
+static void
+image_init (void)
+{
+  if (!hash_init (&images, image_hash, image_less, NULL))
+    PANIC ("couldn't create executable image cache");
+  list_init (&image_lru);
+  lock_init (&image_lock);
+}
+
+/* Reads and checks the headers of executable FILE, named
+   FILE_NAME, and returns a new image of it, or a null pointer if
+   FILE is not a valid executable or memory is short. */
+static struct image *
+image_read (struct file *file, const char *file_name)
+{
+  struct Elf32_Ehdr ehdr;
+  struct image *image;
+  Elf32_Addr base;
+  off_t file_ofs;
+  int i;
+
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
-      || ehdr.e_type != 2
+      || (ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
       || ehdr.e_machine != 3
       || ehdr.e_version != 1
       || ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
       || ehdr.e_phnum > 1024) 
   {
     printf ("load: %s: error loading executable\n", file_name);
-    goto done; 
+    return NULL;
   }
 
+  /* Room for every program header to be loadable. */
+  image = malloc (sizeof *image + ehdr.e_phnum * sizeof *image->segments);
+  if (image == NULL)
+    return NULL;
+  image->type = ehdr.e_type;
+  image->entry = ehdr.e_entry;
+  image->dynamic = 0;
+  image->dynamic_cnt = 0;
+  image->span = 0;
+  image->segment_cnt = 0;
+
+  /* A shared library is linked at address 0 and may be mapped
+     anywhere from LIB_BASE up, so check its segments as if it
+     were mapped there. */
+  base = ehdr.e_type == ET_DYN ? LIB_BASE : 0;
+
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
   for (i = 0; i < ehdr.e_phnum; i++) 
@@ -372,11 +972,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        goto error;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        goto error;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -384,79 +984,608 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_NOTE:
         case PT_PHDR:
         case PT_STACK:
+        case PT_INTERP:
         default:
-          /* Ignore this segment. */
+          /* Ignore this segment.  The kernel itself links programs
+             with their shared libraries, so a PT_INTERP naming a
+             dynamic linker is not needed. */
           break;
         case PT_DYNAMIC:
-        case PT_INTERP:
+          if (phdr.p_memsz < sizeof (struct Elf32_Dyn)
+              || phdr.p_vaddr % sizeof (Elf32_Word) != 0)
+            goto error;
+          image->dynamic = phdr.p_vaddr;
+          image->dynamic_cnt = phdr.p_memsz / sizeof (struct Elf32_Dyn);
+          break;
         case PT_SHLIB:
-          goto done;
+          goto error;
         case PT_LOAD:
-          if (validate_segment (&phdr, file)) 
+          if (validate_segment (&phdr, file, base)) 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct segment *seg = &image->segments[image->segment_cnt++];
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+              seg->writable = (phdr.p_flags & PF_W) != 0;
+              seg->file_page = phdr.p_offset & ~PGMASK;
+              seg->mem_page = phdr.p_vaddr & ~PGMASK;
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
-                     Read initial part from disk and zero the saveptr. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                     Read initial part from disk and zero the rest. */
+                  seg->read_bytes = page_offset + phdr.p_filesz;
+                  seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                               PGSIZE)
+                                     - seg->read_bytes);
                 }
               else 
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg->read_bytes = 0;
+                  seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                              PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
+              if (seg->mem_page + seg->read_bytes + seg->zero_bytes
+                  > image->span)
+                image->span = (seg->mem_page + seg->read_bytes
+                               + seg->zero_bytes);
             }
           else
-            goto done;
+            goto error;
           break;
         }
     }
+  return image;
 
-  /* Set up stack. */
+ error:
+  free (image);
+  return NULL;
+}
+
+/* Removes IMAGE from the cache.  The caller must hold
+   image_lock. */
+static void
+image_uncache (struct image *image)
+{
+  ASSERT (lock_held_by_current_thread (&image_lock));
+  ASSERT (image->cached);
+  hash_delete (&images, &image->elem);
+  list_remove (&image->lru_elem);
+  image->cached = false;
+}
+
+/* Frees IMAGE, which must have left the cache and have no
+   users. */
+static void
+image_free (struct image *image)
+{
+  inode_close (image->inode);
+  free (image);
+}
+
+/* Returns the image of executable FILE, named FILE_NAME, from the
+   cache if it is there and current, otherwise by reading FILE's
+   headers and caching the result.  Returns a null pointer if
+   FILE is not a valid executable or memory is short.  The caller
+   must pass the image to image_put() when done with it. */
+static struct image *
+image_get (struct file *file, const char *file_name)
+{
+  struct inode *inode = file_get_inode (file);
+  struct image *image = NULL;
+  struct image *stale = NULL;
+  struct image *victim = NULL;
+  struct image key;
+  struct hash_elem *e;
+
+  key.sector = inode_get_inumber (inode);
+  lock_acquire (&image_lock);
+  e = hash_find (&images, &key.elem);
+  if (e != NULL)
+    {
+      image = hash_entry (e, struct image, elem);
+      if (image->write_cnt == inode_write_cnt (inode))
+        {
+          image->ref_cnt++;
+          list_remove (&image->lru_elem);
+          list_push_front (&image_lru, &image->lru_elem);
+          image_hit_cnt++;
+          lock_release (&image_lock);
+          return image;
+        }
+
+      /* The file changed since it was parsed. */
+      image_uncache (image);
+      if (image->ref_cnt == 0)
+        stale = image;
+    }
+  image_miss_cnt++;
+  lock_release (&image_lock);
+  if (stale != NULL)
+    image_free (stale);
+
+  image = image_read (file, file_name);
+  if (image == NULL)
+    return NULL;
+  image->sector = key.sector;
+  image->inode = inode_reopen (inode);
+  image->write_cnt = inode_write_cnt (inode);
+  image->ref_cnt = 1;
+  image->cached = false;
+
+  /* Cache the image, unless another process raced us to it. */
+  lock_acquire (&image_lock);
+  if (hash_insert (&images, &image->elem) == NULL)
+    {
+      image->cached = true;
+      list_push_front (&image_lru, &image->lru_elem);
+      if (hash_size (&images) > IMAGE_CACHE_SIZE)
+        {
+          struct image *lru = list_entry (list_back (&image_lru),
+                                          struct image, lru_elem);
+          image_uncache (lru);
+          if (lru->ref_cnt == 0)
+            victim = lru;
+        }
+    }
+  lock_release (&image_lock);
+  if (victim != NULL)
+    image_free (victim);
+  return image;
+}
+
+/* Releases IMAGE, obtained from image_get(), freeing it if it is
+   no longer cached. */
+static void
+image_put (struct image *image)
+{
+  bool dead;
+
+  lock_acquire (&image_lock);
+  ASSERT (image->ref_cnt > 0);
+  dead = --image->ref_cnt == 0 && !image->cached;
+  lock_release (&image_lock);
+  if (dead)
+    image_free (image);
+}
+
+/* Returns a hash value for the image that E refers to. */
+static unsigned
+image_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct image, elem)->sector);
+}
+
+/* Returns true if image A precedes image B. */
+static bool
+image_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct image *a = hash_entry (a_, struct image, elem);
+  const struct image *b = hash_entry (b_, struct image, elem);
+
+  return a->sector < b->sector;
+}
+
+/* Maps the segments of IMAGE, read from FILE, into the running
+   process, BASE bytes above the addresses they were linked at.
+   Returns true if successful, false otherwise. */
+static bool
+map_image (const struct image *image, struct file *file, uint32_t base)
+{
+  size_t i;
+
+  for (i = 0; i < image->segment_cnt; i++)
+    {
+      const struct segment *seg = &image->segments[i];
+      void *upage = (void *) (base + seg->mem_page);
+      if (!load_segment (file, seg->file_page, upage,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        return false;
+    }
+  return true;
+}
+
+/* Dynamic linking.
+
+   A program linked with shared libraries has a PT_DYNAMIC
+   segment, which names the libraries it needs and lists the
+   relocations that bind it to them.  load() does the job of a
+   dynamic linker: it maps each library that the program, or
+   another library, needs, starting at LIB_BASE, and then applies
+   every object's relocations, looking up symbols in each object
+   in the order they were loaded, the program first.
+
+   Libraries must be position-independent and must not relocate
+   their read-only pages (DT_TEXTREL).  Those pages then hold the
+   same bytes in every process, wherever the library is mapped,
+   so with virtual memory a single copy of them serves every
+   process that uses the library, through vm/share.c.  Only the
+   writable pages, which hold the library's data and global
+   offset table, are per-process.  Libraries' initialization
+   functions (DT_INIT) are not run.
+
+   The dynamic sections and the tables they refer to are read
+   through the process's own mapping of each object, so they are
+   paged in on demand like the rest of it, and a malformed
+   object can only make the load fail. */
+
+/* An object being linked: the program or a shared library. */
+struct dso
+  {
+    struct image *image;        /* Parsed headers. */
+    uint32_t base;              /* Load address, 0 for the program. */
+    char name[NAME_MAX + 1];    /* Library's file name. */
+    uint32_t symtab;            /* Symbol table. */
+    uint32_t strtab;            /* String table. */
+    uint32_t hash;              /* Symbol hash table, or 0. */
+    uint32_t rel;               /* Relocations, or 0. */
+    uint32_t relsz;             /* Size of REL. */
+    uint32_t jmprel;            /* PLT relocations, or 0. */
+    uint32_t pltrelsz;          /* Size of JMPREL. */
+    size_t needed_cnt;          /* Number of libraries needed. */
+    Elf32_Word needed[LIB_MAX]; /* Their names' offsets in STRTAB. */
+  };
+
+/* Longest symbol name that can be looked up, plus one. */
+#define SYMBOL_MAX 64
+
+/* Copies SIZE bytes from user address UADDR to DST.  Returns
+   true if successful, false if UADDR is not mapped. */
+static bool
+read_user (void *dst, uint32_t uaddr, size_t size)
+{
+  return copy_from_user (dst, (const void *) uaddr, size) == 0;
+}
+
+/* Reads D's dynamic section, whose address and size D->image
+   gives.  Returns true if successful, false if it is missing
+   something or asks for something unsupported. */
+static bool
+read_dynamic (struct dso *d)
+{
+  size_t i;
+
+  for (i = 0; i < d->image->dynamic_cnt; i++)
+    {
+      struct Elf32_Dyn dyn;
+
+      if (!read_user (&dyn, d->base + d->image->dynamic + i * sizeof dyn,
+                      sizeof dyn))
+        return false;
+      switch (dyn.d_tag)
+        {
+        case DT_NULL:
+          return d->symtab != 0 && d->strtab != 0;
+        case DT_NEEDED:
+          if (d->needed_cnt >= LIB_MAX)
+            return false;
+          d->needed[d->needed_cnt++] = dyn.d_val;
+          break;
+        case DT_HASH:
+          d->hash = d->base + dyn.d_val;
+          break;
+        case DT_STRTAB:
+          d->strtab = d->base + dyn.d_val;
+          break;
+        case DT_SYMTAB:
+          d->symtab = d->base + dyn.d_val;
+          break;
+        case DT_REL:
+          d->rel = d->base + dyn.d_val;
+          break;
+        case DT_RELSZ:
+          d->relsz = dyn.d_val;
+          break;
+        case DT_JMPREL:
+          d->jmprel = d->base + dyn.d_val;
+          break;
+        case DT_PLTRELSZ:
+          d->pltrelsz = dyn.d_val;
+          break;
+        case DT_PLTREL:
+          if (dyn.d_val != DT_REL)
+            return false;
+          break;
+        case DT_TEXTREL:
+          return false;
+        }
+    }
+  return false;
+}
+
+/* Returns the ELF hash of NAME.  See [ELF1] 2-19. */
+static uint32_t
+elf_hash (const char *name)
+{
+  uint32_t h = 0;
+
+  while (*name != '\0')
+    {
+      uint32_t g;
+
+      h = (h << 4) + (unsigned char) *name++;
+      g = h & 0xf0000000;
+      if (g != 0)
+        h ^= g >> 24;
+      h &= ~g;
+    }
+  return h;
+}
+
+/* Looks up the global symbol NAME among those that D defines,
+   using its hash table.  If found, stores it in *SYM and returns
+   true. */
+static bool
+find_symbol (const struct dso *d, const char *name, struct Elf32_Sym *sym)
+{
+  uint32_t nbucket, nchain, idx, hops;
+
+  if (d->hash == 0
+      || !read_user (&nbucket, d->hash, sizeof nbucket)
+      || !read_user (&nchain, d->hash + 4, sizeof nchain)
+      || nbucket == 0
+      || !read_user (&idx, d->hash + 8 + elf_hash (name) % nbucket * 4,
+                     sizeof idx))
+    return false;
+
+  /* Follow the chain, but no further than it could be long. */
+  for (hops = 0; idx != 0 && hops < nchain; hops++)
+    {
+      char sym_name[SYMBOL_MAX];
+
+      if (!read_user (sym, d->symtab + idx * sizeof *sym, sizeof *sym))
+        return false;
+      if (sym->st_shndx != SHN_UNDEF
+          && ELF32_ST_BIND (sym->st_info) != STB_LOCAL
+          && copy_string_from_user (sym_name,
+                                    (const char *) (d->strtab + sym->st_name),
+                                    sizeof sym_name)
+          && !strcmp (sym_name, name))
+        return true;
+      if (!read_user (&idx, d->hash + 8 + (nbucket + idx) * 4, sizeof idx))
+        return false;
+    }
+  return false;
+}
+
+/* Stores in *VALUE the address of symbol SYM_IDX in D's symbol
+   table, looking it up in each of the DSO_CNT objects in DSOS
+   unless it is local to D.  Returns false if the symbol cannot
+   be found, reporting it on behalf of program FILE_NAME. */
+static bool
+resolve (const struct dso dsos[], size_t dso_cnt, const struct dso *d,
+         uint32_t sym_idx, uint32_t *value, const char *file_name)
+{
+  struct Elf32_Sym sym;
+  char name[SYMBOL_MAX];
+  size_t i;
+
+  if (sym_idx == 0)
+    {
+      *value = 0;
+      return true;
+    }
+  if (!read_user (&sym, d->symtab + sym_idx * sizeof sym, sizeof sym))
+    return false;
+  if (ELF32_ST_BIND (sym.st_info) == STB_LOCAL)
+    {
+      *value = d->base + sym.st_value;
+      return true;
+    }
+  if (!copy_string_from_user (name, (const char *) (d->strtab + sym.st_name),
+                              sizeof name))
+    return false;
+
+  for (i = 0; i < dso_cnt; i++)
+    {
+      struct Elf32_Sym def;
+      if (find_symbol (&dsos[i], name, &def))
+        {
+          *value = dsos[i].base + def.st_value;
+          return true;
+        }
+    }
+  if (ELF32_ST_BIND (sym.st_info) == STB_WEAK)
+    {
+      *value = 0;
+      return true;
+    }
+  printf ("load: %s: undefined symbol %s\n", file_name, name);
+  return false;
+}
+
+/* Returns true if the word at user address ADDR lies within one
+   of D's writable segments. */
+static bool
+is_relocatable (const struct dso *d, uint32_t addr)
+{
+  size_t i;
+
+  for (i = 0; i < d->image->segment_cnt; i++)
+    {
+      const struct segment *seg = &d->image->segments[i];
+      uint32_t start = d->base + seg->mem_page;
+      uint32_t end = start + seg->read_bytes + seg->zero_bytes;
+      if (seg->writable && addr >= start && addr <= end - sizeof addr)
+        return true;
+    }
+  return false;
+}
+
+/* Applies the relocations in the SIZE bytes at user address
+   TABLE to D, resolving symbols among the DSO_CNT objects in
+   DSOS.  Returns true if successful, false otherwise. */
+static bool
+relocate (const struct dso dsos[], size_t dso_cnt, const struct dso *d,
+          uint32_t table, uint32_t size, const char *file_name)
+{
+  uint32_t ofs;
+
+  for (ofs = 0; ofs + sizeof (struct Elf32_Rel) <= size;
+       ofs += sizeof (struct Elf32_Rel))
+    {
+      struct Elf32_Rel rel;
+      uint32_t addr, word, value;
+      int type;
+
+      if (!read_user (&rel, table + ofs, sizeof rel))
+        return false;
+      type = ELF32_R_TYPE (rel.r_info);
+      if (type == R_386_NONE)
+        continue;
+      addr = d->base + rel.r_offset;
+      if (!is_relocatable (d, addr) || !read_user (&word, addr, sizeof word))
+        return false;
+
+      if (type == R_386_RELATIVE)
+        word += d->base;
+      else
+        {
+          if (!resolve (dsos, dso_cnt, d, ELF32_R_SYM (rel.r_info), &value,
+                        file_name))
+            return false;
+          switch (type)
+            {
+            case R_386_32:
+              word += value;
+              break;
+            case R_386_PC32:
+              word += value - addr;
+              break;
+            case R_386_GLOB_DAT:
+            case R_386_JMP_SLOT:
+              word = value;
+              break;
+            default:
+              printf ("load: %s: unsupported relocation type %d\n",
+                      file_name, type);
+              return false;
+            }
+        }
+      if (copy_to_user ((void *) addr, &word, sizeof word) != 0)
+        return false;
+    }
+  return true;
+}
+
+/* Opens the shared library named D->name, maps it at *BASE, and
+   advances *BASE past it.  The library stays open, and closed to
+   writes, until the running process exits.  Returns true if
+   successful, false otherwise. */
+static bool
+load_library (struct dso *d, uint32_t *base)
+{
+  struct thread *t = thread_current ();
+  struct file *file;
+
+  file = filesys_open (d->name);
+  if (file == NULL)
+    {
+      printf ("load: %s: open failed\n", d->name);
+      return false;
+    }
+  t->libs[t->lib_cnt++] = file;
+  file_deny_write (file);
+
+  d->image = image_get (file, d->name);
+  if (d->image == NULL)
+    return false;
+  if (d->image->type != ET_DYN || d->image->dynamic == 0
+      || d->image->span > LIB_LIMIT - *base)
+    {
+      printf ("load: %s: error loading shared library\n", d->name);
+      return false;
+    }
+  d->base = *base;
+  *base += ROUND_UP (d->image->span, PGSIZE);
+  return map_image (d->image, file, d->base) && read_dynamic (d);
+}
+
+/* Links program FILE_NAME, whose IMAGE the running process has
+   just mapped, with the shared libraries that it needs.  Returns
+   true if successful, false otherwise. */
+static bool
+link_program (struct image *image, const char *file_name)
+{
+  struct dso dsos[LIB_MAX + 1];
+  size_t dso_cnt = 1;
+  uint32_t base = LIB_BASE;
+  bool success = false;
+  size_t i, j, k;
 
-  if (!setup_stack (esp,file_name))
+  memset (dsos, 0, sizeof dsos);
+  dsos[0].image = image;
+  if (!read_dynamic (&dsos[0]))
     goto done;
 
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+  /* Load each library needed by an object already loaded, once.
+     This visits the libraries loaded along the way, too. */
+  for (i = 0; i < dso_cnt; i++)
+    for (j = 0; j < dsos[i].needed_cnt; j++)
+      {
+        const char *uname = (const char *) (dsos[i].strtab
+                                            + dsos[i].needed[j]);
+        char name[NAME_MAX + 1];
+        struct dso *d;
+
+        if (!copy_string_from_user (name, uname, sizeof name))
+          goto done;
+        for (k = 1; k < dso_cnt; k++)
+          if (!strcmp (dsos[k].name, name))
+            break;
+        if (k < dso_cnt)
+          continue;
+        if (dso_cnt > LIB_MAX)
+          goto done;
+        d = &dsos[dso_cnt++];
+        strlcpy (d->name, name, sizeof d->name);
+        if (!load_library (d, &base))
+          goto done;
+      }
 
+  for (i = 0; i < dso_cnt; i++)
+    if (!relocate (dsos, dso_cnt, &dsos[i], dsos[i].rel, dsos[i].relsz,
+                   file_name)
+        || !relocate (dsos, dso_cnt, &dsos[i], dsos[i].jmprel,
+                      dsos[i].pltrelsz, file_name))
+      goto done;
   success = true;
 
  done:
-  /* We arrive here whether the load is successful or not. */
-  if(!success)
-  {
-    file_close (file);
-  }
-  else
-  {
-    t->file = file;
-    file_deny_write(t->file);
-  }
+  for (i = 1; i < dso_cnt; i++)
+    if (dsos[i].image != NULL)
+      image_put (dsos[i].image);
   return success;
 }
-
-/* load() helpers. */
 
+/* Prints statistics for the executable image cache. */
+void
+process_print_stats (void)
+{
+  long long lookups = image_hit_cnt + image_miss_cnt;
+
+  printf ("Exec: %lld loads, %lld image cache hits (%lld%%)\n",
+          lookups, image_hit_cnt,
+          lookups > 0 ? image_hit_cnt * 100 / lookups : 0);
+}
+
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
-   FILE and returns true if so, false otherwise. */
+   FILE, when mapped BASE bytes above its virtual address, and
+   returns true if so, false otherwise. */
 static bool
-validate_segment (const struct Elf32_Phdr *phdr, struct file *file) 
+validate_segment (const struct Elf32_Phdr *phdr, struct file *file,
+                  Elf32_Addr base) 
 {
+  Elf32_Addr vaddr = phdr->p_vaddr + base;
+
+  /* Adding BASE must not wrap around. */
+  if (vaddr < base)
+    return false;
+
   /* p_offset and p_vaddr must have the same page offset. */
   if ((phdr->p_offset & PGMASK) != (phdr->p_vaddr & PGMASK)) 
     return false; 
@@ -475,14 +1604,14 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
   
   /* The virtual memory region must both start and end within the
      user address space range. */
-  if (!is_user_vaddr ((void *) phdr->p_vaddr))
+  if (!is_user_vaddr ((void *) vaddr))
     return false;
-  if (!is_user_vaddr ((void *) (phdr->p_vaddr + phdr->p_memsz)))
+  if (!is_user_vaddr ((void *) (vaddr + phdr->p_memsz)))
     return false;
 
   /* The region cannot "wrap around" across the kernel virtual
      address space. */
-  if (phdr->p_vaddr + phdr->p_memsz < phdr->p_vaddr)
+  if (vaddr + phdr->p_memsz < vaddr)
     return false;
 
   /* Disallow mapping page 0.
@@ -490,7 +1619,7 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
      it then user code that passed a null pointer to system calls
      could quite likely panic the kernel by way of null pointer
      assertions in memcpy(), etc. */
-  if (phdr->p_vaddr < PGSIZE)
+  if (vaddr < PGSIZE)
     return false;
 
   /* It's okay. */
@@ -509,6 +1638,12 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only entered in the
+   supplemental page table, to be read from FILE or zeroed when
+   the process first touches them.  Without it, the pages are
+   allocated and mapped LOAD_BATCH at a time, so that a large
+   segment does not cost a trip to the page allocator per page.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -519,7 +1654,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
+#ifdef VM
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -528,98 +1663,153 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-      /* Get a page of memory. */
-      uint8_t *kpage = palloc_get_page (PAL_USER);
-      if (kpage == NULL)
+      /* Record where the page's contents are.  A page with
+         nothing to read, such as BSS, is demand-zero. */
+      struct page *p = page_allocate (upage, writable);
+      if (p == NULL)
         return false;
-
-      /* Load this page. */
-      if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
+      if (page_read_bytes > 0)
         {
-          palloc_free_page (kpage);
-          return false; 
-        }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
-
-      /* Add the page to the process's address space. */
-      if (!install_page (upage, kpage, writable)) 
-        {
-          palloc_free_page (kpage);
-          return false; 
+          p->file = file;
+          p->file_ofs = ofs;
+          p->read_bytes = page_read_bytes;
+          p->executable = true;
         }
+      ofs += page_read_bytes;
 
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
       upage += PGSIZE;
     }
+#else
+  file_seek (file, ofs);
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      void *kpages[LOAD_BATCH];
+      size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+      size_t i;
+
+      /* Get pages of memory for the next batch. */
+      if (page_cnt > LOAD_BATCH)
+        page_cnt = LOAD_BATCH;
+      if (!palloc_get_pages (PAL_USER, kpages, page_cnt))
+        return false;
+
+      /* Load them.  We will read PAGE_READ_BYTES bytes from FILE
+         into each and zero the final PAGE_ZERO_BYTES bytes. */
+      for (i = 0; i < page_cnt; i++)
+        {
+          size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+          size_t page_zero_bytes = PGSIZE - page_read_bytes;
+          uint8_t *kpage = kpages[i];
+
+          if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
+            {
+              palloc_free_pages (kpages, page_cnt);
+              return false; 
+            }
+          memset (kpage + page_read_bytes, 0, page_zero_bytes);
+          read_bytes -= page_read_bytes;
+          zero_bytes -= page_zero_bytes;
+        }
+
+      /* Add them to the process's address space. */
+      if (!pagedir_set_pages (thread_current ()->pagedir, upage,
+                              kpages, page_cnt, writable))
+        {
+          palloc_free_pages (kpages, page_cnt);
+          return false; 
+        }
+      upage += page_cnt * PGSIZE;
+    }
+#endif
   return true;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory, and push the program's arguments on it. */
 //***added file_name to signature
 static bool
 setup_stack (void **esp, const char* file_name) 
 {
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+#ifdef VM
+  /* The stack page is demand-zero like BSS.  Lock it in while we
+     push the arguments. */
+  if (page_allocate (upage, true) == NULL || !page_lock (upage, true))
+    return false;
+  push_arguments (esp, file_name);
+  page_unlock (upage);
+  return true;
+#else
   uint8_t *kpage;
-  bool success = false;
-  char* myesp = (char*)*esp; //my esp, so we don't have to double dereference
 
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL) 
+  if (kpage == NULL)
+    return false;
+  if (!install_page (upage, kpage, true))
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
-      {
-        //otis driving
-        myesp = PHYS_BASE;
-        char* fn_copy; //copy of file name
-        fn_copy = palloc_get_page (0);
-        strlcpy (fn_copy, file_name, PGSIZE); //copy file_name into fn_copy
-    
-        char* saveptr=NULL; //used in strtok_r to save the place
-        char* token=NULL; //the token from strtok_r
-        int argc=0; //number of command line arguments
-        char* argv[25]; //command line arguments, max in 25
-        token= strtok_r(fn_copy," ",&saveptr); //get token
-        while(token!=NULL) //while still arguments to parse
-        { 
-          //gavin driving
-          size_t size = strlen(token)+1; //see function
-          myesp-=size; //move esp
-          argv[argc]=myesp; //save pointers to the arguments inside argv
-          strlcpy(myesp,token,size); //"push" argument onto stack
-          token=strtok_r(NULL," ",&saveptr); //get next token(argument)
-          argc++;
-        }
-        myesp -= (unsigned int)myesp % 4;
-        argv[argc]=NULL; //last argument in argv has to be null
-
-        int i;
-        for(i=argc;i>=0;i--) //loops through argv, pushing the pointers
-        {                      //that were stored there onto the stack
-          myesp-=sizeof(char*);
-          *(int*)myesp=(int)argv[i];
-        }
-
-        //ryan driving
-        myesp-=sizeof(char**); 
-        *(int*)myesp=myesp+4; //pushing pointer to argv
-        myesp-=sizeof(int);
-        *myesp=(int)(argc); //pushing argc
-        myesp-=4;
-        *myesp=0; //pushing null
-        palloc_free_page (fn_copy);
-      }
-      else
-        palloc_free_page (kpage);
+      palloc_free_page (kpage);
+      return false;
     }
-    *esp = myesp;
-    // hex_dump((int)*esp,*esp,PHYS_BASE-*esp,1);
-  return success;
+  push_arguments (esp, file_name);
+  return true;
+#endif
 }
 
+/* Pushes the words of FILE_NAME onto the freshly mapped user
+   stack as argc and argv for main(), plus a fake return address,
+   and stores the resulting stack pointer in *ESP. */
+static void
+push_arguments (void **esp, const char* file_name)
+{
+  //otis driving
+  char* myesp = PHYS_BASE; //my esp, so we don't have to double dereference
+  char* fn_copy; //copy of file name
+  fn_copy = palloc_get_page (0);
+  strlcpy (fn_copy, file_name, PGSIZE); //copy file_name into fn_copy
+
+  char* saveptr=NULL; //used in strtok_r to save the place
+  char* token=NULL; //the token from strtok_r
+  int argc=0; //number of command line arguments
+  char* argv[25]; //command line arguments, max in 25
+  token= strtok_r(fn_copy," ",&saveptr); //get token
+  while(token!=NULL) //while still arguments to parse
+  { 
+    //gavin driving
+    size_t size = strlen(token)+1; //see function
+    myesp-=size; //move esp
+    argv[argc]=myesp; //save pointers to the arguments inside argv
+    strlcpy(myesp,token,size); //"push" argument onto stack
+    token=strtok_r(NULL," ",&saveptr); //get next token(argument)
+    argc++;
+  }
+  myesp -= (unsigned int)myesp % 4;
+  argv[argc]=NULL; //last argument in argv has to be null
+
+  int i;
+  for(i=argc;i>=0;i--) //loops through argv, pushing the pointers
+  {                      //that were stored there onto the stack
+    myesp-=sizeof(char*);
+    *(int*)myesp=(int)argv[i];
+  }
+
+  //ryan driving
+  myesp-=sizeof(char**); 
+  *(int*)myesp=myesp+4; //pushing pointer to argv
+  myesp-=sizeof(int);
+  *myesp=(int)(argc); //pushing argc
+  myesp-=4;
+  *myesp=0; //pushing null
+  palloc_free_page (fn_copy);
+
+  *esp = myesp;
+  // hex_dump((int)*esp,*esp,PHYS_BASE-*esp,1);
+}
+
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -639,4 +1829,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
-
+#endif
@@ -1,14 +1,33 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/block.h"
+#include "filesys/directory.h"
+#include "filesys/off_t.h"
 
 typedef int pid_t;
 
+/* An open file, as saved in a checkpoint. */
+struct saved_file
+  {
+    int fd;                     /* File descriptor. */
+    block_sector_t sector;      /* Inode sector. */
+    off_t pos;                  /* Current position. */
+    char name[NAME_MAX + 1];    /* Name it was opened by. */
+  };
+
+void process_init (void);
 tid_t process_execute (const char *file_name);
+#ifdef VM
+tid_t process_fork (const struct intr_frame *);
+bool process_checkpoint (const char *file_name, const struct intr_frame *,
+                         const struct saved_file[], size_t file_cnt);
+#endif
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
-struct thread* list_contains_pid(struct list*, tid_t, int option);
+void process_print_stats (void);
 
 #endif /* userprog/process.h */
@@ -1,6 +1,15 @@
 #include "userprog/syscall.h"
+#include "userprog/usercopy.h"
+#include "filesys/inode.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
+static int get_arg (const int *);
+static char *copy_in_string (const char *);
+static bool lock_buffer (const void *, unsigned size, bool will_write);
+static void unlock_buffer (const void *, unsigned size);
 
 static file_pointer file_array[128];
 static struct semaphore mutex;
@@ -41,11 +50,11 @@ syscall_handler (struct intr_frame *f)
 {
     //ryan driving
     int* myesp = (int*)f->esp;
-    if(!is_good_ptr(myesp)) {
-      exit(-1);
-    }
-
-    int code = *myesp++;
+#ifdef VM
+    /* Saved for stack growth on page faults in the kernel. */
+    thread_current ()->user_esp = f->esp;
+#endif
+    int code = get_arg(myesp++);
 
     switch(code)
     {
@@ -54,85 +63,113 @@ syscall_handler (struct intr_frame *f)
         break;
       case SYS_EXIT:
       {
-        int arg1 = *myesp++;
+        int arg1 = get_arg(myesp++);
         f->eax = arg1;
         exit(arg1);
         break;
       }
       case SYS_EXEC:
       {
-        char* arg1 = (char*)*myesp++;
+        char* arg1 = (char*)get_arg(myesp++);
         f->eax = exec(arg1);
         break;
       }
       case SYS_WAIT:
       {
-        pid_t arg1 = (pid_t)*myesp++;
+        pid_t arg1 = (pid_t)get_arg(myesp++);
         f->eax = wait(arg1);
         break;
       }
       case SYS_CREATE:
       {
-        char* arg1 = (char*)*myesp++;
-        unsigned arg2 = (unsigned)*myesp++;
+        char* arg1 = (char*)get_arg(myesp++);
+        unsigned arg2 = (unsigned)get_arg(myesp++);
         f->eax = create(arg1,arg2);
         break;
       }
       case SYS_REMOVE:
       {
-        char* arg1 = (char*)*myesp++;
+        char* arg1 = (char*)get_arg(myesp++);
         f->eax = remove(arg1);
         break;
       }
       // gavin driving
       case SYS_OPEN:
       {
-        char* arg1 = (char*)*myesp++;
+        char* arg1 = (char*)get_arg(myesp++);
         f->eax = open(arg1);
         break;
       }
       case SYS_FILESIZE:
       {
-        int arg1 = *myesp++;
+        int arg1 = get_arg(myesp++);
         f->eax = filesize(arg1);
         break;
       }
       case SYS_READ:
       {
-        int arg1 = *myesp++;
-        void* arg2 = (void*)*myesp++;
-        unsigned arg3 = (unsigned)*myesp++;
+        int arg1 = get_arg(myesp++);
+        void* arg2 = (void*)get_arg(myesp++);
+        unsigned arg3 = (unsigned)get_arg(myesp++);
         f->eax = read(arg1,arg2,arg3);
         break;
       }
       case SYS_WRITE:
       {
-        int arg1 = *myesp++;
-        void* arg2 = (void*)*myesp++;
-        unsigned arg3 = (unsigned)*myesp++;
+        int arg1 = get_arg(myesp++);
+        void* arg2 = (void*)get_arg(myesp++);
+        unsigned arg3 = (unsigned)get_arg(myesp++);
         f->eax = write(arg1,arg2,arg3);
         break;
       }
       // billy driving
       case SYS_SEEK:
       {
-        int arg1 = *myesp++;
-        unsigned arg2 = (unsigned)*myesp++;
+        int arg1 = get_arg(myesp++);
+        unsigned arg2 = (unsigned)get_arg(myesp++);
         seek(arg1,arg2);
         break;
       }
       case SYS_TELL:
       {
-        int arg1 = *myesp++;
+        int arg1 = get_arg(myesp++);
         f->eax = tell(arg1);
         break;
       }
       case SYS_CLOSE:
       {
-        int arg1 = *myesp++;
+        int arg1 = get_arg(myesp++);
         close(arg1);
         break;
       }
+#ifdef VM
+      case SYS_MMAP:
+      {
+        int arg1 = get_arg(myesp++);
+        void* arg2 = (void*)get_arg(myesp++);
+        f->eax = mmap(arg1,arg2);
+        break;
+      }
+      case SYS_MUNMAP:
+      {
+        mapid_t arg1 = (mapid_t)get_arg(myesp++);
+        munmap(arg1);
+        break;
+      }
+      case SYS_FORK:
+        /* TID_ERROR doubles as the pid for failure. */
+        f->eax = process_fork(f);
+        break;
+      case SYS_CHECKPOINT:
+      {
+        char* arg1 = (char*)get_arg(myesp++);
+        f->eax = checkpoint(arg1,f);
+        break;
+      }
+#endif
+      case SYS_BLKSTATS:
+        block_dump_stats();
+        break;
       default:
         exit(-1);
     }
@@ -156,13 +193,12 @@ void exit(int status)
 
 pid_t exec(const char* cmd_line)
 {
-  if(!is_good_ptr(cmd_line))
-  {
-    sema_up(&mutex);
+  char *kcmd_line = copy_in_string(cmd_line);
+  if(kcmd_line == NULL)
     exit(-1);
-  }
   
-  pid_t pid = process_execute(cmd_line);
+  pid_t pid = process_execute(kcmd_line);
+  palloc_free_page(kcmd_line);
 
   sema_down(&thread_current()->exec_sema);
   if(!thread_current()->child_load_success)
@@ -176,25 +212,20 @@ pid_t exec(const char* cmd_line)
 //gavin driving
 int wait(pid_t pid)
 { 
-  int status = (int)process_wait(pid);
-
-  struct thread *child = list_contains_pid(&all_list, pid, 2);
-
-  return status;
+  return process_wait(pid);
 }
 
 bool create(const char* file, unsigned initial_size)
 {
-  sema_down(&mutex);
-  if(!is_good_ptr(file))
-  {
-    sema_up(&mutex);
+  char *kfile = copy_in_string(file);
+  if(kfile == NULL)
     exit(-1);
-    return 0;
-  }
-  bool result = filesys_create(file, initial_size);
+
+  sema_down(&mutex);
+  bool result = filesys_create(kfile, initial_size);
 
   sema_up(&mutex);
+  palloc_free_page(kfile);
 
   return result;
 }
@@ -202,16 +233,15 @@ bool create(const char* file, unsigned initial_size)
 //otis driving
 bool remove(const char* file)
 {
-  sema_down(&mutex);
-  if(!is_good_ptr(file))
-  {
-    sema_up(&mutex);
+  char *kfile = copy_in_string(file);
+  if(kfile == NULL)
     return 0;
-  }
 
-  bool result = filesys_remove(file);
+  sema_down(&mutex);
+  bool result = filesys_remove(kfile);
 
   sema_up(&mutex);
+  palloc_free_page(kfile);
 
   return result;
 }
@@ -219,38 +249,33 @@ bool remove(const char* file)
 //billy driving
 int open(const char* file)
 {
-  sema_down(&mutex);
-  if(!is_good_ptr(file))
-  {
-    sema_up(&mutex);
+  char *kfile = copy_in_string(file);
+  if(kfile == NULL)
     exit(-1);
-    return -1;
-  }
 
+  sema_down(&mutex);
+
+  int result = -1;
   int i = 2;
   for (; i<128; i++) 
   {
     if (!file_array[i].file)
     {
-      if ((file_array[i].file = filesys_open(file)) == NULL)
+      if ((file_array[i].file = filesys_open(kfile)) != NULL)
       {
-        sema_up(&mutex);
-        return -1;
-      }
-      else 
-      {
-        strlcpy(file_array[i].name, file, strlen(file));
+        strlcpy(file_array[i].name, kfile, PGSIZE);
         file_array[i].open_flag=1;
         file_array[i].owner = thread_current()->tid;
-        sema_up(&mutex);
-        return i;
+        result = i;
       }
+      break;
     }
   }
 
   sema_up(&mutex);
+  palloc_free_page(kfile);
 
-  return -1;
+  return result;
 }
 
 void close(int fd)
@@ -313,7 +338,7 @@ int read(int fd, void* buffer, unsigned size)
   sema_up(&mutex);
 
   int result = -1;
-  if(!is_good_ptr(buffer))
+  if(!lock_buffer(buffer, size, true))
   {
     sema_down(&mutex);
     readcount--;
@@ -327,6 +352,7 @@ int read(int fd, void* buffer, unsigned size)
   {
     result = file_read(file_array[fd].file, buffer, size);
   }
+  unlock_buffer(buffer, size);
 
   // billy driving
   sema_down(&mutex);
@@ -349,7 +375,7 @@ int write(int fd, const void* buffer, unsigned size)
   }
   sema_down(&file_array[fd].resource);
   int result = -1;
-  if(!is_good_ptr(buffer))
+  if(!lock_buffer(buffer, size, false))
   {
     sema_up(&file_array[fd].resource);
     sema_up(&mutex);
@@ -372,6 +398,7 @@ int write(int fd, const void* buffer, unsigned size)
   {
     result = file_write(file_array[fd].file, buffer, size);
   }
+  unlock_buffer(buffer, size);
   sema_up(&file_array[fd].resource);
   sema_up(&mutex);
 	return result;
@@ -417,18 +444,195 @@ unsigned tell(int fd)
  	return result;
 }
 
-//billy driving
-bool is_good_ptr(void* ptr)
+#ifdef VM
+/* Maps the file open as FD into memory at ADDR.  The mapping
+   gets its own handle on the file, so it survives close(). */
+mapid_t mmap(int fd, void *addr)
 {
-  if(is_kernel_vaddr((char *)ptr) || ptr==NULL)
+  struct file *file;
+
+  sema_down(&mutex);
+  if (fd < 2 || fd >= 128 || file_array[fd].open_flag==0
+      || file_array[fd].file == NULL
+      || thread_current()->tid != file_array[fd].owner)
   {
-    // exit(-1);
-    return false;
+    sema_up(&mutex);
+    return MAP_FAILED;
   }
-  else if(pagedir_get_page(thread_current()->pagedir, ptr) == NULL)
+  file = file_reopen(file_array[fd].file);
+  mapid_t result = file != NULL ? mmap_map(file, addr) : MAP_FAILED;
+  sema_up(&mutex);
+
+  return result;
+}
+
+/* Removes MAPPING, writing modified pages back to its file. */
+void munmap(mapid_t mapping)
+{
+  sema_down(&mutex);
+  mmap_unmap(mapping);
+  sema_up(&mutex);
+}
+
+/* Saves the running process, whose registers are in F, to a new
+   file named FILE, along with the files it has open.  Returns 0
+   if successful, -1 on failure, including when an open file's
+   name is too long to save.  A process later loaded from FILE
+   returns 1 from this same call. */
+int checkpoint(const char* file, const struct intr_frame *f)
+{
+  char *kfile = copy_in_string(file);
+  if(kfile == NULL)
+    exit(-1);
+
+  struct saved_file *files = palloc_get_page(0);
+  if(files == NULL)
+  {
+    palloc_free_page(kfile);
+    return -1;
+  }
+
+  sema_down(&mutex);
+  size_t cnt = 0;
+  bool names_fit = true;
+  int i = 2;
+  for (; i<128; i++)
+  {
+    if (file_array[i].file != NULL
+        && file_array[i].owner == thread_current()->tid)
+    {
+      struct inode *inode = file_get_inode(file_array[i].file);
+      files[cnt].fd = i;
+      files[cnt].sector = inode_get_inumber(inode);
+      files[cnt].pos = file_tell(file_array[i].file);
+      /* A file saved under a cut-off name could never be reopened. */
+      if (strlcpy(files[cnt].name, file_array[i].name, sizeof files[cnt].name)
+          >= sizeof files[cnt].name)
+      {
+        names_fit = false;
+        break;
+      }
+      cnt++;
+    }
+  }
+  int result = -1;
+  if (names_fit)
+    result = process_checkpoint(kfile, f, files, cnt) ? 0 : -1;
+  sema_up(&mutex);
+
+  palloc_free_page(files);
+  palloc_free_page(kfile);
+  return result;
+}
+
+/* Reopens the CNT FILES saved in a checkpoint, under the same
+   file descriptors, for the running process.  Each is opened by
+   its name, which must still name the same file, so that a
+   checkpoint cannot open anything the process could not.  Either
+   all of them are reopened or, on failure, none. */
+bool syscall_restore_files(const struct saved_file files[], size_t cnt)
+{
+  size_t i;
+
+  sema_down(&mutex);
+  for (i = 0; i < cnt; i++)
+  {
+    int fd = files[i].fd;
+    if (fd < 2 || fd >= 128 || file_array[fd].open_flag != 0
+        || memchr(files[i].name, '\0', sizeof files[i].name) == NULL)
+    {
+      sema_up(&mutex);
+      return false;
+    }
+  }
+  for (i = 0; i < cnt; i++)
   {
-    // exit(-1);
-    return false;
+    int fd = files[i].fd;
+    struct file *file = NULL;
+    if (file_array[fd].open_flag == 0)
+      file = filesys_open(files[i].name);
+    if (file != NULL
+        && inode_get_inumber(file_get_inode(file)) != files[i].sector)
+    {
+      file_close(file);
+      file = NULL;
+    }
+    if (file == NULL)
+    {
+      /* Undo the ones already reopened. */
+      while (i-- > 0)
+      {
+        file_close(file_array[files[i].fd].file);
+        file_array[files[i].fd].file = NULL;
+        file_array[files[i].fd].open_flag = 0;
+        strlcpy(file_array[files[i].fd].name,"",1);
+      }
+      sema_up(&mutex);
+      return false;
+    }
+    file_seek(file, files[i].pos);
+    file_array[fd].file = file;
+    strlcpy(file_array[fd].name, files[i].name, sizeof files[i].name);
+    file_array[fd].open_flag = 1;
+    file_array[fd].owner = thread_current()->tid;
   }
+  sema_up(&mutex);
   return true;
 }
+#endif
+
+/* Returns the 32-bit system call argument at user address
+   UADDR, killing the process if it cannot be read. */
+static int
+get_arg (const int *uaddr)
+{
+  int value;
+
+  if (copy_from_user (&value, uaddr, sizeof value) != 0)
+    exit (-1);
+  return value;
+}
+
+/* Copies the string at user address USTR into a new page, which
+   the caller must free with palloc_free_page().  Returns a null
+   pointer if USTR is not a valid string of less than a page or
+   if memory is short. */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+
+  if (kstr != NULL && !copy_string_from_user (kstr, ustr, PGSIZE))
+    {
+      palloc_free_page (kstr);
+      kstr = NULL;
+    }
+  return kstr;
+}
+
+/* Makes the SIZE bytes of user memory at BUFFER safe for the
+   kernel to access, for writing if WILL_WRITE is true, until
+   unlock_buffer() is called.  Device drivers may transfer data
+   straight to or from BUFFER while holding their locks, so it
+   must not fault in the middle.  Returns false if BUFFER is not
+   entirely valid. */
+static bool
+lock_buffer (const void *buffer, unsigned size, bool will_write)
+{
+#ifdef VM
+  return page_lock_range (buffer, size, will_write);
+#else
+  /* Without virtual memory, nothing is ever unmapped, so it is
+     enough to check that it is all mapped now. */
+  return probe_user_range (buffer, size, will_write);
+#endif
+}
+
+/* Releases the SIZE bytes at BUFFER locked by lock_buffer(). */
+static void
+unlock_buffer (const void *buffer UNUSED, unsigned size UNUSED)
+{
+#ifdef VM
+  page_unlock_range (buffer, size);
+#endif
+}
@@ -8,12 +8,16 @@
 #include "threads/synch.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "devices/block.h"
 #include "devices/shutdown.h"
 #include "userprog/process.h"
 #include "lib/string.h"
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "pagedir.h"
+#ifdef VM
+#include "vm/mmap.h"
+#endif
 
 typedef struct {
 	struct file *file;
@@ -37,6 +41,11 @@ int write(int fd, const void* buffer,unsigned size);
 void seek(int fd,unsigned position);
 unsigned tell(int fd);
 void close(int fd);
-bool is_good_ptr(void*);
+#ifdef VM
+mapid_t mmap(int fd, void *addr);
+void munmap(mapid_t mapping);
+int checkpoint(const char* file, const struct intr_frame *f);
+bool syscall_restore_files(const struct saved_file files[], size_t cnt);
+#endif
 
 #endif /* userprog/syscall.h */
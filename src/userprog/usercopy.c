@@ -0,0 +1,151 @@
+#include "userprog/usercopy.h"
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* The kernel accesses user memory on a process's behalf
+   directly, without first looking up each page in the page
+   directory.  If a page turns out not to be mapped, the page
+   fault handler finds the faulting instruction in the exception
+   table and, instead of treating the fault as a kernel bug,
+   resumes at the fixup address that the table gives for it,
+   where the access reports failure.  Faults are rare, so this
+   is much cheaper than checking each access in advance, and it
+   covers every byte of a buffer, not just the first.
+
+   Each instruction that may touch user memory gets an entry in
+   the "ex_table" section, which the linker script gathers
+   between _start_ex_table and _end_ex_table.  Only the
+   instructions here access user memory this way, so the table
+   is short. */
+
+/* An exception table entry. */
+struct ex_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Returns true if the SIZE bytes starting at UADDR all lie below
+   PHYS_BASE.  They need not be mapped. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  uintptr_t end = start + size;
+
+  return end >= start && end <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST, stopping at the first byte
+   that faults.  Returns the number of bytes not copied.  On a
+   fault, "rep movsb" leaves the count of bytes still to copy in
+   ECX, which is just what we return. */
+static size_t
+copy_bytes (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                ".pushsection ex_table, \"a\"\n"
+                ".balign 4\n"
+                ".long 1b, 2b\n"
+                ".popsection"
+                : "+c" (size), "+D" (dst), "+S" (src)
+                :
+                : "memory");
+  return size;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns the number of bytes that could not be copied,
+   which is 0 if successful. */
+size_t
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  if (!is_user_range (usrc, size))
+    return size;
+  return copy_bytes (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns the number of bytes that could not be copied,
+   which is 0 if successful. */
+size_t
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  if (!is_user_range (udst, size))
+    return size;
+  return copy_bytes (udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE-byte buffer DST.  Returns true if successful, false if
+   the string is not entirely in valid user memory or does not
+   fit in SIZE bytes along with its null terminator.
+
+   Copies a page at a time, since a page is either mapped or not
+   as a whole, and then looks for the terminator in the copy. */
+bool
+copy_string_from_user (char *dst, const char *usrc, size_t size)
+{
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (usrc);
+      if (chunk > size)
+        chunk = size;
+
+      if (copy_from_user (dst, usrc, chunk) != 0)
+        return false;
+      if (memchr (dst, '\0', chunk) != NULL)
+        return true;
+
+      dst += chunk;
+      usrc += chunk;
+      size -= chunk;
+    }
+  return false;
+}
+
+/* Returns true if every page in the SIZE bytes starting at user
+   address UADDR is mapped, and writable if WRITE is true.
+   Touches one byte in each page. */
+bool
+probe_user_range (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *addr = uaddr;
+  const uint8_t *end = addr + size;
+
+  if (!is_user_range (uaddr, size))
+    return false;
+  while (addr < end)
+    {
+      uint8_t byte;
+
+      if (copy_from_user (&byte, addr, 1) != 0
+          || (write && copy_to_user ((void *) addr, &byte, 1) != 0))
+        return false;
+      addr = (const uint8_t *) pg_round_down (addr) + PGSIZE;
+    }
+  return true;
+}
+
+/* Called by the page fault handler for a fault in kernel mode
+   that it cannot resolve.  If F's instruction is in the
+   exception table, makes F resume at its fixup address and
+   returns true.  Otherwise, returns false. */
+bool
+usercopy_fixup (struct intr_frame *f)
+{
+  const struct ex_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void (*) (void)) e->fixup;
+        return true;
+      }
+  return false;
+}
@@ -0,0 +1,16 @@
+#ifndef USERPROG_USERCOPY_H
+#define USERPROG_USERCOPY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct intr_frame;
+
+size_t copy_from_user (void *dst, const void *usrc, size_t size);
+size_t copy_to_user (void *udst, const void *src, size_t size);
+bool copy_string_from_user (char *dst, const char *usrc, size_t size);
+bool probe_user_range (const void *uaddr, size_t size, bool write);
+
+bool usercopy_fixup (struct intr_frame *);
+
+#endif /* userprog/usercopy.h */
@@ -0,0 +1,490 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "vm/page.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+
+/* The frame table takes over every page in the user pool at
+   boot and hands frames out to pages as they are brought in.
+   When no frame is free, it picks victims with the clock
+   algorithm: the hand sweeps the table, and a frame whose page
+   was accessed since the last sweep gets a second chance.
+
+   A frame may hold a page shared by several processes after
+   fork(), in which case it lists all of their pages and is
+   evicted from all of them at once.
+
+   One more frame, outside the table, holds zeros.  Every page
+   that is all zeros and has only been read shares it, so that it
+   never needs a frame of its own or a trip to swap.  It is never
+   evicted and always counts as shared, so that it is always
+   mapped read-only.  Because its contents never change and it
+   never goes away, it needs no locking or pinning: frame_lock()
+   and the functions after it leave it alone, and its lock is
+   only held briefly to add and remove pages.  Otherwise every
+   process reading zero pages would wait on every other.
+
+   Each frame has a lock.  A thread holds it while it fills the
+   frame, while it changes the pages that share it, and while it
+   evicts them.  The evictor only ever tries to acquire frame
+   locks, so it never waits on a frame that is busy.
+
+   A system call that accesses user memory keeps the frames
+   involved in memory by pinning them, which counts them in
+   PIN_CNT, instead of holding their locks for the whole call.
+   Pages of different processes may share frames in any order,
+   and two pages of one process may share a frame after merging,
+   so holding the locks of a whole buffer at once could deadlock.
+   The evictor and the merging thread leave pinned frames
+   alone.
+
+   So that page faults seldom have to wait for eviction, a
+   reclaim thread keeps some frames free in the background.  An
+   allocation that leaves fewer than LOW_WATER frames free wakes
+   it up, and it then evicts pages with the same clock until
+   HIGH_WATER frames are free. */
+
+/* Maximum number of frames evicted at once.  Their pages are
+   written to consecutive swap slots, which turns scattered
+   single-page writes into one sequential transfer. */
+#define EVICT_CLUSTER SWAP_CLUSTER
+
+static struct frame *frames;    /* All frames. */
+static size_t frame_cnt;        /* Number of frames. */
+static struct frame zero_frame; /* Frame of zeros. */
+
+static struct lock scan_lock;   /* Serializes frame allocation. */
+static size_t hand;             /* Clock hand. */
+
+/* Frames that hold no page, including cached executable pages
+   that no process maps.  Updated with interrupts off, since each
+   frame is protected by its own lock. */
+static size_t free_cnt;
+
+static size_t low_water;        /* Wake the reclaimer below this. */
+static size_t high_water;       /* Reclaimer stops here. */
+static struct semaphore reclaim_sema; /* Upped to wake reclaimer. */
+static bool reclaim_wanted;     /* Reclaimer woken but not done? */
+
+static void reclaim_thread (void *aux);
+
+/* Initializes the frame table with all the pages in the user
+   pool. */
+void
+frame_init (void)
+{
+  void *base;
+
+  lock_init (&scan_lock);
+
+  lock_init (&zero_frame.lock);
+  zero_frame.base = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (zero_frame.base == NULL)
+    PANIC ("no memory for frame of zeros");
+  list_init (&zero_frame.pages);
+  zero_frame.share = NULL;
+  zero_frame.pin_cnt = 0;
+
+  frames = malloc (sizeof *frames * init_ram_pages);
+  if (frames == NULL)
+    PANIC ("out of memory allocating frame table");
+
+  while ((base = palloc_get_page (PAL_USER)) != NULL)
+    {
+      struct frame *f = &frames[frame_cnt++];
+      lock_init (&f->lock);
+      f->base = base;
+      list_init (&f->pages);
+      f->share = NULL;
+      f->pin_cnt = 0;
+    }
+  free_cnt = frame_cnt;
+
+  /* Keep about 1/32 of the frames free, but at least a cluster's
+     worth, reclaiming twice as many each time. */
+  low_water = frame_cnt / 32;
+  if (low_water < EVICT_CLUSTER)
+    low_water = EVICT_CLUSTER;
+  high_water = low_water * 2;
+  if (high_water > frame_cnt / 2)
+    {
+      /* Too little memory to be worth it. */
+      low_water = high_water = 0;
+      return;
+    }
+  sema_init (&reclaim_sema, 0);
+  thread_create ("reclaim", PRI_DEFAULT, reclaim_thread, NULL);
+}
+
+/* Tries to acquire F's lock without waiting, for eviction.
+   Frames pinned by a system call never qualify, nor do frames
+   that the running thread already holds, such as the one that
+   unshare_page() is copying. */
+static bool
+try_lock (struct frame *f)
+{
+  if (lock_held_by_current_thread (&f->lock)
+      || !lock_try_acquire (&f->lock))
+    return false;
+  if (f->pin_cnt > 0)
+    {
+      lock_release (&f->lock);
+      return false;
+    }
+  return true;
+}
+
+/* Returns true if any page in F, which the caller must have
+   locked, was accessed since the last call, and clears the
+   accessed bits of all of them. */
+static bool
+frame_accessed_recently (struct frame *f)
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_accessed_recently (list_entry (e, struct page, frame_elem)))
+      accessed = true;
+  return accessed;
+}
+
+/* Tries once to find a frame for PAGE, evicting other pages if
+   necessary.  Returns the frame, locked, or a null pointer if
+   none could be freed. */
+static struct frame *
+try_frame_alloc_and_lock (struct page *page)
+{
+  struct frame *victims[EVICT_CLUSTER];
+  struct inode *inodes[EVICT_CLUSTER];
+  struct frame *result = NULL;
+  size_t victim_cnt = 0;
+  size_t i;
+
+  lock_acquire (&scan_lock);
+
+  /* Look for a free frame, leaving alone those that keep an
+     executable's page cached for the next process to run it. */
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = &frames[i];
+      if (!try_lock (f))
+        continue;
+      if (list_empty (&f->pages) && f->share == NULL)
+        {
+          frame_attach (f, page);
+          lock_release (&scan_lock);
+          return f;
+        }
+      lock_release (&f->lock);
+    }
+
+  /* Sweep the clock hand to collect a cluster of victims. */
+  for (i = 0; i < frame_cnt * 2 && victim_cnt < EVICT_CLUSTER; i++)
+    {
+      struct frame *f = &frames[hand];
+      if (++hand >= frame_cnt)
+        hand = 0;
+
+      if (!try_lock (f))
+        continue;
+      if (list_empty (&f->pages))
+        {
+          /* Freed since the first pass, or cached but unused: no
+             need to evict. */
+          struct inode *inode;
+
+          while (victim_cnt > 0)
+            lock_release (&victims[--victim_cnt]->lock);
+          inode = share_remove (f);
+          frame_attach (f, page);
+          lock_release (&scan_lock);
+
+          /* F now holds only PAGE, which no other thread can
+             reach yet, so keeping it locked here holds up no
+             one. */
+          inode_close (inode);
+          return f;
+        }
+      if (frame_accessed_recently (f))
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+      victims[victim_cnt++] = f;
+    }
+  lock_release (&scan_lock);
+
+  /* Evict the victims' pages together.  Keep the first frame
+     that was freed and release the others for later use. */
+  page_out (victims, victim_cnt);
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct frame *f = victims[i];
+      inodes[i] = list_empty (&f->pages) ? share_remove (f) : NULL;
+      if (result == NULL && list_empty (&f->pages))
+        {
+          frame_attach (f, page);
+          result = f;
+        }
+      else
+        lock_release (&f->lock);
+    }
+  for (i = 0; i < victim_cnt; i++)
+    inode_close (inodes[i]);
+  return result;
+}
+
+/* Evicts one cluster of pages chosen by the clock, leaving
+   their frames free.  Returns the number of frames freed. */
+static size_t
+reclaim_cluster (void)
+{
+  struct frame *victims[EVICT_CLUSTER];
+  size_t victim_cnt = 0;
+  size_t freed = 0;
+  size_t i;
+
+  lock_acquire (&scan_lock);
+  for (i = 0; i < frame_cnt * 2 && victim_cnt < EVICT_CLUSTER; i++)
+    {
+      struct frame *f = &frames[hand];
+      if (++hand >= frame_cnt)
+        hand = 0;
+
+      if (!try_lock (f))
+        continue;
+      if (list_empty (&f->pages) || frame_accessed_recently (f))
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+      victims[victim_cnt++] = f;
+    }
+  lock_release (&scan_lock);
+
+  page_out (victims, victim_cnt);
+  for (i = 0; i < victim_cnt; i++)
+    {
+      if (list_empty (&victims[i]->pages))
+        freed++;
+      lock_release (&victims[i]->lock);
+    }
+  return freed;
+}
+
+/* Reclaim thread.  Each time it is woken, evicts pages until
+   HIGH_WATER frames are free or nothing more can be evicted. */
+static void
+reclaim_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      sema_down (&reclaim_sema);
+      while (free_cnt < high_water)
+        if (reclaim_cluster () == 0)
+          {
+            /* Every frame is busy or swap is full.  Let the
+               faulting processes take over. */
+            break;
+          }
+      reclaim_wanted = false;
+    }
+}
+
+/* Wakes the reclaim thread if few frames are left free. */
+static void
+check_water (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool wake = free_cnt < low_water && !reclaim_wanted;
+  if (wake)
+    reclaim_wanted = true;
+  intr_set_level (old_level);
+
+  if (wake)
+    sema_up (&reclaim_sema);
+}
+
+/* Finds a frame for PAGE, evicting other pages if necessary.
+   Returns the frame, locked, or a null pointer if no frame can
+   be freed, e.g. because every frame is locked or swap is
+   full. */
+struct frame *
+frame_alloc_and_lock (struct page *page)
+{
+  int try;
+
+  for (try = 0; try < 3; try++)
+    {
+      struct frame *f = try_frame_alloc_and_lock (page);
+      if (f != NULL)
+        {
+          ASSERT (lock_held_by_current_thread (&f->lock));
+          check_water ();
+          return f;
+        }
+
+      /* Give threads that have frames locked a chance to
+         release them. */
+      timer_msleep (100);
+    }
+  return NULL;
+}
+
+/* Returns the number of frames in the frame table. */
+size_t
+frame_count (void)
+{
+  return frame_cnt;
+}
+
+/* Returns the frame at index IDX in the frame table. */
+struct frame *
+frame_at (size_t idx)
+{
+  ASSERT (idx < frame_cnt);
+  return &frames[idx];
+}
+
+/* Adds PAGE, which must not be resident, to the pages that share
+   the frame of zeros, and returns that frame.  It counts as
+   locked, but the frame of zeros never needs to be. */
+struct frame *
+frame_share_zero (struct page *page)
+{
+  frame_attach (&zero_frame, page);
+  return &zero_frame;
+}
+
+/* Locks P's frame, if it has one, so that it cannot be evicted.
+   P's frame may be evicted while we wait for the lock, in which
+   case P ends up with no frame and nothing is locked. */
+void
+frame_lock (struct page *p)
+{
+  /* Only the owner of P gives it a frame, so P->frame can change
+     from nonnull to null under us, but not the other way.  It
+     can also change to another frame if P's frame is merged
+     into one with identical contents, so try again then. */
+  for (;;)
+    {
+      struct frame *f = p->frame;
+      if (f == NULL || f == &zero_frame)
+        return;
+      lock_acquire (&f->lock);
+      if (f == p->frame)
+        return;
+      lock_release (&f->lock);
+    }
+}
+
+/* Unlocks F, which the running thread must have locked. */
+void
+frame_unlock (struct frame *f)
+{
+  if (f == &zero_frame)
+    return;
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Pins F, which the running thread must have locked, so that
+   it stays in memory until a matching call to frame_unpin(),
+   even after F is unlocked. */
+void
+frame_pin (struct frame *f)
+{
+  if (f == &zero_frame)
+    return;
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  f->pin_cnt++;
+}
+
+/* Unpins F, which must be pinned and not locked by the running
+   thread. */
+void
+frame_unpin (struct frame *f)
+{
+  if (f == &zero_frame)
+    return;
+  lock_acquire (&f->lock);
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  lock_release (&f->lock);
+}
+
+/* Adds P to the pages that share F, which the running thread
+   must have locked.  The caller sets P's FRAME. */
+void
+frame_attach (struct frame *f, struct page *p)
+{
+  if (f == &zero_frame)
+    {
+      lock_acquire (&zero_frame.lock);
+      list_push_back (&zero_frame.pages, &p->frame_elem);
+      lock_release (&zero_frame.lock);
+      return;
+    }
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  if (list_empty (&f->pages))
+    {
+      enum intr_level old_level = intr_disable ();
+      free_cnt--;
+      intr_set_level (old_level);
+    }
+  list_push_back (&f->pages, &p->frame_elem);
+}
+
+/* Removes P from the pages that share F, which the running
+   thread must have locked.  F stays locked. */
+void
+frame_detach (struct frame *f, struct page *p)
+{
+  ASSERT (p->frame == f);
+  if (f == &zero_frame)
+    {
+      lock_acquire (&zero_frame.lock);
+      list_remove (&p->frame_elem);
+      lock_release (&zero_frame.lock);
+      return;
+    }
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  list_remove (&p->frame_elem);
+  if (list_empty (&f->pages))
+    {
+      enum intr_level old_level = intr_disable ();
+      free_cnt++;
+      intr_set_level (old_level);
+    }
+}
+
+/* Removes P from F, as frame_detach() does, and unlocks F.  If
+   no other page shares F, it becomes free for use by another
+   page. */
+void
+frame_release (struct frame *f, struct page *p)
+{
+  frame_detach (f, p);
+  frame_unlock (f);
+}
+
+/* Returns true if more than one page shares F, or if F is the
+   frame of zeros. */
+bool
+frame_is_shared (struct frame *f)
+{
+  return (f == &zero_frame
+          || (!list_empty (&f->pages)
+              && list_front (&f->pages) != list_back (&f->pages)));
+}
@@ -0,0 +1,38 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+struct page;
+
+/* A physical frame of user memory.  Several pages may share a
+   frame, copy-on-write; the frame is free when none does. */
+struct frame
+  {
+    struct lock lock;           /* Held while filled, changed, or evicted. */
+    int pin_cnt;                /* System calls keeping it in memory. */
+    void *base;                 /* Kernel virtual base address. */
+    struct list pages;          /* Pages sharing the frame. */
+    struct share *share;        /* Cache entry, if an executable's
+                                   read-only page (vm/share.c). */
+  };
+
+void frame_init (void);
+
+struct frame *frame_alloc_and_lock (struct page *);
+struct frame *frame_share_zero (struct page *);
+size_t frame_count (void);
+struct frame *frame_at (size_t idx);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+void frame_pin (struct frame *);
+void frame_unpin (struct frame *);
+void frame_attach (struct frame *, struct page *);
+void frame_detach (struct frame *, struct page *);
+void frame_release (struct frame *, struct page *);
+bool frame_is_shared (struct frame *);
+
+#endif /* vm/frame.h */
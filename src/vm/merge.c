@@ -0,0 +1,170 @@
+#include "vm/merge.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Processes that run the same program, or programs built the
+   same way, often end up with frames of identical data, such as
+   heaps of zeros and unmodified copies of data segments.  A
+   low-priority thread looks for them and merges each set into a
+   single frame shared copy-on-write, freeing the rest.
+
+   Once a second, the thread hashes the contents of every frame
+   in use.  A frame whose hash changed since the last pass is
+   being written to and would likely be copied again soon after
+   a merge, so only frames whose hash held steady are candidates.
+   Candidates are sorted by hash, and page_merge() compares the
+   frames with equal hashes byte for byte and merges those that
+   match.
+
+   The thread only ever tries to acquire frame locks, like the
+   evictor, so it never holds up a process. */
+
+/* Time between passes, in milliseconds. */
+#define MERGE_INTERVAL 1000
+
+/* A frame that is a candidate for merging. */
+struct candidate
+  {
+    unsigned hash;              /* Hash of its contents. */
+    struct frame *frame;        /* The frame. */
+  };
+
+static unsigned *hashes;                /* Each frame's hash last pass. */
+static struct candidate *candidates;    /* Candidates this pass. */
+static size_t merge_cnt;                /* Frames freed by merging. */
+
+static void merge_thread (void *aux);
+
+/* Starts the merging thread. */
+void
+merge_init (void)
+{
+  size_t frame_cnt = frame_count ();
+
+  if (frame_cnt == 0)
+    return;
+  hashes = calloc (frame_cnt, sizeof *hashes);
+  candidates = malloc (frame_cnt * sizeof *candidates);
+  if (hashes == NULL || candidates == NULL)
+    PANIC ("out of memory allocating page merging tables");
+  thread_create ("merge", PRI_MIN, merge_thread, NULL);
+}
+
+/* Compares candidates A and B by hash, for qsort(). */
+static int
+compare_candidates (const void *a_, const void *b_)
+{
+  const struct candidate *a = a_;
+  const struct candidate *b = b_;
+
+  return a->hash < b->hash ? -1 : a->hash > b->hash;
+}
+
+/* Hashes every frame in use and returns the number of
+   candidates for merging stored in CANDIDATES. */
+static size_t
+find_candidates (void)
+{
+  size_t frame_cnt = frame_count ();
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = frame_at (i);
+      unsigned hash;
+
+      if (!lock_try_acquire (&f->lock))
+        continue;
+      if (list_empty (&f->pages) || f->share != NULL)
+        {
+          lock_release (&f->lock);
+          hashes[i] = 0;
+          continue;
+        }
+      hash = hash_bytes (f->base, PGSIZE);
+      lock_release (&f->lock);
+
+      if (hash == hashes[i])
+        {
+          candidates[cnt].hash = hash;
+          candidates[cnt].frame = f;
+          cnt++;
+        }
+      hashes[i] = hash;
+    }
+  return cnt;
+}
+
+/* Merges frames among the CNT sorted candidates whose hashes are
+   equal. */
+static void
+merge_candidates (size_t cnt)
+{
+  size_t i, j;
+
+  for (i = 0; i < cnt; i = j)
+    {
+      struct frame *keep = candidates[i].frame;
+
+      for (j = i + 1; j < cnt && candidates[j].hash == candidates[i].hash;
+           j++)
+        {
+          struct frame *f = candidates[j].frame;
+
+          if (!lock_try_acquire (&keep->lock))
+            continue;
+          if (lock_try_acquire (&f->lock))
+            {
+              if (page_merge (keep, f))
+                merge_cnt++;
+              lock_release (&f->lock);
+            }
+          lock_release (&keep->lock);
+        }
+    }
+}
+
+/* Merging thread. */
+static void
+merge_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      size_t cnt;
+
+      timer_msleep (MERGE_INTERVAL);
+      cnt = find_candidates ();
+      qsort (candidates, cnt, sizeof *candidates, compare_candidates);
+      merge_candidates (cnt);
+    }
+}
+
+/* Prints the number of frames freed by merging, and the number
+   of frames that sharing of any kind currently saves. */
+void
+merge_print_stats (void)
+{
+  size_t frame_cnt = frame_count ();
+  size_t saved = 0;
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = frame_at (i);
+      size_t pages = list_size (&f->pages);
+      if (pages > 1)
+        saved += pages - 1;
+    }
+  printf ("Page merging: %zu frames merged, %zu frames saved by sharing\n",
+          merge_cnt, saved);
+}
@@ -0,0 +1,7 @@
+#ifndef VM_MERGE_H
+#define VM_MERGE_H
+
+void merge_init (void);
+void merge_print_stats (void);
+
+#endif /* vm/merge.h */
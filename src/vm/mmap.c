@@ -0,0 +1,128 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* A file mapped into a process's address space.  Its pages are
+   ordinary supplemental page table entries that read from the
+   file on first access, like executable pages, except that
+   modified pages are written back to the file instead of to
+   swap: on eviction, on unmapping, and at process exit. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's mappings. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Mapped file, owned by mapping. */
+    uint8_t *base;              /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+  };
+
+static void unmap (struct mapping *);
+
+/* Maps all of FILE into the running process's address space,
+   starting at page-aligned user address ADDR.  The mapping takes
+   ownership of FILE, which should be a separate handle from any
+   the process uses otherwise.  Returns the mapping's identifier,
+   or MAP_FAILED if FILE is empty, ADDR is unsuitable, or the
+   mapping would overlap pages already in use; in that case,
+   FILE is closed. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  off_t length = file_length (file);
+  struct mapping *m;
+  size_t i;
+
+  if (length == 0 || addr == NULL || pg_ofs (addr) != 0
+      || !is_user_vaddr (addr)
+      || (size_t) length > (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) addr))
+    goto fail;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    goto fail;
+  m->file = file;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      struct page *p = page_allocate (m->base + ofs, true);
+      if (p == NULL)
+        {
+          while (i-- > 0)
+            page_deallocate (m->base + i * PGSIZE);
+          free (m);
+          goto fail;
+        }
+      p->file = file;
+      p->file_ofs = ofs;
+      p->read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      p->write_back = true;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+
+ fail:
+  file_close (file);
+  return MAP_FAILED;
+}
+
+/* Removes mapping ID from the running process, writing modified
+   pages back to the file.  Returns false if the process has no
+   such mapping. */
+bool
+mmap_unmap (mapid_t id)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        {
+          unmap (m);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Removes all of the running process's mappings, writing
+   modified pages back to their files. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_front (&t->mappings), struct mapping, elem));
+}
+
+/* Removes M from the running process and frees it. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  /* Unmap the whole range at once, so that the TLB is flushed
+     only once.  The dirty bits survive for the write-back. */
+  list_remove (&m->elem);
+  pagedir_clear_pages (thread_current ()->pagedir, m->base, m->page_cnt);
+  for (i = 0; i < m->page_cnt; i++)
+    page_deallocate (m->base + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
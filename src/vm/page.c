@@ -0,0 +1,852 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+
+/* The supplemental page table records, for each page of a
+   process's user address space, where its contents come from.
+   Pages are not brought into memory until the process first
+   touches them: page_fault() calls page_in(), which allocates a
+   frame, fills it from swap, from the executable, or with zeros,
+   and maps it into the page directory.  When frames run out, the
+   frame table calls page_out() to evict pages: those modified
+   since they were brought in go to swap, or back to their file
+   for memory-mapped files, and the rest are dropped, because
+   they can be brought in again the same way.
+
+   A page that is all zeros is not given a frame of its own until
+   it is written.  Until then, reading it maps the frame of zeros
+   that all such pages share, read-only.
+
+   A fault on a page that loads from a file also maps the pages
+   that follow it in the same file, the way a sequential scan
+   would touch them next.  Each process adapts how many: the
+   window doubles each time a fault lands just past the pages
+   mapped around the previous one, and halves otherwise.
+
+   fork() copies an address space lazily: the child's pages share
+   the parent's frames and swap slots, and both are mapped
+   read-only.  The first write to such a page faults, and
+   page_in() gives the writer a copy of its own.
+
+   The lock on a page's frame protects its FRAME and SWAP_SLOT
+   members against concurrent eviction. */
+
+/* Maximum size of a user stack, in pages.  Set with -sl. */
+size_t stack_page_limit = 2048;
+
+/* Print each process's page fault statistics when it exits?  Set
+   with -fault-stats. */
+bool print_fault_stats;
+
+/* Fault-around window, in pages: initial and maximum. */
+#define AROUND_INIT 4
+#define AROUND_MAX 16
+
+static unsigned page_hash (const struct hash_elem *, void *);
+static bool page_less (const struct hash_elem *, const struct hash_elem *,
+                       void *);
+static struct page *find_page (const void *upage);
+static bool map_page (struct page *, bool dirty);
+static void destroy_page (struct hash_elem *, void *);
+
+/* Creates an empty supplemental page table for the running
+   process.  Returns true if successful, false on memory
+   allocation failure. */
+bool
+page_table_create (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->pages == NULL);
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash, page_less, NULL))
+    {
+      free (t->pages);
+      t->pages = NULL;
+      return false;
+    }
+  t->around_window = AROUND_INIT;
+  return true;
+}
+
+/* Returns the running process's own copy of FILE, which is
+   PARENT's executable or one of its shared libraries. */
+static struct file *
+own_file (struct thread *parent, struct file *file)
+{
+  struct thread *t = thread_current ();
+  int i;
+
+  if (file == parent->file)
+    return t->file;
+  for (i = 0; i < parent->lib_cnt; i++)
+    if (file == parent->libs[i])
+      return t->libs[i];
+  NOT_REACHED ();
+}
+
+/* Makes the running process's address space, which must be
+   empty, a copy-on-write copy of PARENT's, which must not change
+   while this runs.  Resident pages end up shared between the two
+   processes, read-only; pages in swap share their slots; and the
+   others load from the same place in the running process's own
+   executable or shared library, opened by start_fork().
+   Memory-mapped files are not inherited.  Returns true if
+   successful, false on memory allocation failure. */
+bool
+page_table_copy (struct thread *parent)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *cp;
+
+      if (pp->write_back)
+        continue;
+
+      cp = page_allocate (pp->upage, pp->writable);
+      if (cp == NULL)
+        return false;
+      if (pp->file != NULL)
+        {
+          cp->file = own_file (parent, pp->file);
+          cp->file_ofs = pp->file_ofs;
+          cp->read_bytes = pp->read_bytes;
+          cp->executable = pp->executable;
+        }
+
+      frame_lock (pp);
+      if (pp->swap_slot != SWAP_SLOT_NONE)
+        {
+          swap_dup (pp->swap_slot);
+          cp->swap_slot = pp->swap_slot;
+        }
+      if (pp->frame != NULL)
+        {
+          /* Share the frame.  Whether it differs from the copy on
+             disk is recorded in the dirty bit, so the child's
+             mapping needs the parent's. */
+          uint32_t *ppd = parent->pagedir;
+          bool dirty = (pagedir_get_page (ppd, pp->upage) != NULL
+                        && pagedir_is_dirty (ppd, pp->upage));
+          bool success;
+
+          frame_attach (pp->frame, cp);
+          cp->frame = pp->frame;
+          success = map_page (pp, dirty) && map_page (cp, dirty);
+          frame_unlock (pp->frame);
+          if (!success)
+            return false;
+        }
+    }
+  return true;
+}
+
+/* Prints the running process's page fault statistics, if
+   enabled with -fault-stats. */
+void
+page_print_stats (void)
+{
+  struct thread *t = thread_current ();
+
+  if (print_fault_stats && t->pages != NULL)
+    printf ("%s: %u page faults, %u from files, "
+            "%u pages mapped around, window %u\n",
+            t->name, t->fault_cnt, t->file_fault_cnt, t->around_cnt,
+            t->around_window);
+}
+
+/* Frees the running process's supplemental page table and all
+   the frames that its pages occupy.  Must be called before the
+   process's page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages != NULL)
+    {
+      /* Unmap everything at once, flushing the TLB only once,
+         before freeing the pages one by one. */
+      if (t->pagedir != NULL)
+        pagedir_clear_pages (t->pagedir, NULL,
+                             (uintptr_t) PHYS_BASE / PGSIZE);
+      hash_destroy (t->pages, destroy_page);
+      free (t->pages);
+      t->pages = NULL;
+    }
+}
+
+/* Calls FUNC on each page of the running process, other than
+   pages of memory-mapped files, passing AUX along.  FUNC must not
+   add or remove pages.  Stops and returns false as soon as FUNC
+   returns false, otherwise returns true. */
+bool
+page_table_walk (bool (*func) (struct page *, void *aux), void *aux)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  hash_first (&i, t->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      if (!p->write_back && !func (p, aux))
+        return false;
+    }
+  return true;
+}
+
+/* Adds a page at user virtual address UPAGE to the running
+   process's page table, initially all zeros and writable by the
+   process if WRITABLE is true.  The caller may then set its file
+   backing.  Returns the new page, or a null pointer if UPAGE is
+   already part of the address space or on memory allocation
+   failure. */
+struct page *
+page_allocate (void *upage, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->thread = t;
+  p->writable = writable;
+  p->frame = NULL;
+  p->swap_slot = SWAP_SLOT_NONE;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  p->write_back = false;
+  p->executable = false;
+
+  if (hash_insert (t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Returns the page in the running process's address space that
+   contains user virtual address ADDR, or a null pointer if ADDR
+   is not part of the address space.
+
+   The stack grows on demand: if ADDR is not yet mapped but lies
+   within stack_page_limit pages of the top of user memory, and
+   no lower than 32 bytes below the user stack pointer, the
+   farthest that PUSHA reaches, then a new zeroed stack page is
+   added and returned. */
+struct page *
+page_for_addr (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  if (t->pages == NULL || !is_user_vaddr (addr))
+    return NULL;
+
+  p = find_page (pg_round_down (addr));
+  if (p != NULL)
+    return p;
+
+  if ((uint8_t *) addr >= (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE
+      && (uint8_t *) addr >= (uint8_t *) t->user_esp - 32)
+    return page_allocate (pg_round_down (addr), true);
+  return NULL;
+}
+
+/* Removes the page at UPAGE from the running process's address
+   space and frees it.  A modified page of a memory-mapped file
+   is written back first. */
+void
+page_deallocate (void *upage)
+{
+  struct page *p = find_page (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (thread_current ()->pages, &p->hash_elem);
+  destroy_page (&p->hash_elem, NULL);
+}
+
+/* Returns the page at UPAGE in the running process's page table,
+   or a null pointer if there is none. */
+static struct page *
+find_page (const void *upage)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = (void *) upage;
+  e = hash_find (thread_current ()->pages, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Maps P, whose frame the caller must have locked, into its
+   page directory in place of any existing mapping, and sets the
+   mapping's dirty bit to DIRTY.  P is mapped read-only if it
+   shares its frame, so that the first write faults.  Returns
+   true if successful, false on memory allocation failure. */
+static bool
+map_page (struct page *p, bool dirty)
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  pagedir_clear_page (pd, p->upage);
+  if (!pagedir_set_page (pd, p->upage, p->frame->base,
+                         p->writable && !frame_is_shared (p->frame)))
+    return false;
+  if (dirty)
+    pagedir_set_dirty (pd, p->upage, true);
+  return true;
+}
+
+/* Gives P, whose frame the caller must have locked and which
+   shares it with other pages, a copy of the frame to itself.
+   Returns true if successful, in which case P's new frame is
+   locked, or false if no frame is available, in which case P
+   keeps the shared frame, still locked.  P's mapping still
+   refers to the old frame; the caller must remap it. */
+static bool
+unshare_page (struct page *p)
+{
+  struct frame *old = p->frame;
+  struct frame *new;
+
+  /* The eviction scan skips OLD while we hold its lock, so its
+     contents stay put while we find a frame to copy them to. */
+  frame_detach (old, p);
+  new = frame_alloc_and_lock (p);
+  if (new == NULL)
+    {
+      frame_attach (old, p);
+      return false;
+    }
+  memcpy (new->base, old->base, PGSIZE);
+  p->frame = new;
+  frame_unlock (old);
+  return true;
+}
+
+/* Reads P's initial contents from its file into KPAGE.  Reads
+   of programs and libraries are charged to exec, as load()
+   charges their headers.  Returns true if successful, false on
+   a short read. */
+static bool
+read_page (struct page *p, void *kpage)
+{
+  enum block_caller old_caller;
+  bool success;
+
+  if (!p->executable)
+    return (file_read_at (p->file, kpage, p->read_bytes, p->file_ofs)
+            == (off_t) p->read_bytes);
+
+  old_caller = block_set_caller (BLOCK_CALLER_EXEC);
+  success = (file_read_at (p->file, kpage, p->read_bytes, p->file_ofs)
+             == (off_t) p->read_bytes);
+  block_set_caller (old_caller);
+  return success;
+}
+
+/* Gives P, which must not be resident, a frame and fills it
+   with P's contents, or finds a frame that another process
+   already filled if P is a read-only page of an executable.  If
+   P is all zeros and WILL_WRITE is false, P gets the shared
+   frame of zeros instead.  Returns true if successful, in which
+   case the frame is locked, or false on failure. */
+static bool
+load_page (struct page *p, bool will_write)
+{
+  ASSERT (p->frame == NULL);
+
+  if (!will_write && p->swap_slot == SWAP_SLOT_NONE && p->read_bytes == 0
+      && !p->write_back)
+    {
+      p->frame = frame_share_zero (p);
+      return true;
+    }
+  if (share_lookup (p) != NULL)
+    return true;
+
+  p->frame = frame_alloc_and_lock (p);
+  if (p->frame == NULL)
+    return false;
+
+  if (p->swap_slot != SWAP_SLOT_NONE)
+    swap_in (p);
+  else
+    {
+      uint8_t *kpage = p->frame->base;
+
+      if (p->file != NULL && !read_page (p, kpage))
+        {
+          frame_release (p->frame, p);
+          p->frame = NULL;
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+      share_add (p->frame, p);
+    }
+  return true;
+}
+
+/* Locks P's frame, bringing P in first if it is not resident,
+   and maps it into P's page directory if it is not already.  If
+   WILL_WRITE is true, P must be writable, and it is mapped
+   writable, copying its frame first if it is shared.  Returns
+   true if successful, in which case P's frame is locked, or
+   false on failure. */
+static bool
+lock_and_map (struct page *p, bool will_write)
+{
+  uint32_t *pd = p->thread->pagedir;
+  bool present, dirty;
+
+  ASSERT (!will_write || p->writable);
+
+  frame_lock (p);
+  if (p->frame == NULL && !load_page (p, will_write))
+    return false;
+
+  present = pagedir_get_page (pd, p->upage) != NULL;
+  if (present && (!will_write || pagedir_is_writable (pd, p->upage)))
+    return true;
+
+  /* A copy keeps the dirty bit of the mapping it came from,
+     because it differs from the copy on disk just as much. */
+  dirty = present && pagedir_is_dirty (pd, p->upage);
+  if ((will_write && frame_is_shared (p->frame) && !unshare_page (p))
+      || !map_page (p, dirty))
+    {
+      frame_unlock (p->frame);
+      return false;
+    }
+  return true;
+}
+
+/* Maps up to CNT pages that follow P in its address space and in
+   its file, stopping at the first that does not, bringing them
+   in as needed.  Consecutive pages of the file tend to be
+   consecutive on disk, so reading them now costs little more
+   than the read for P itself.  Returns the number of pages
+   newly mapped. */
+static size_t
+fault_around (struct page *p, size_t cnt)
+{
+  uint32_t *pd = p->thread->pagedir;
+  size_t mapped = 0;
+  size_t i;
+
+  for (i = 1; i <= cnt; i++)
+    {
+      uint8_t *upage = (uint8_t *) p->upage + i * PGSIZE;
+      struct page *q;
+
+      if (!is_user_vaddr (upage))
+        break;
+      q = find_page (upage);
+      if (q == NULL || q->file != p->file
+          || q->file_ofs != p->file_ofs + (off_t) (i * PGSIZE)
+          || q->swap_slot != SWAP_SLOT_NONE)
+        break;
+      if (pagedir_get_page (pd, upage) != NULL)
+        continue;
+      if (!lock_and_map (q, false))
+        break;
+      frame_unlock (q->frame);
+      mapped++;
+    }
+  return mapped;
+}
+
+/* Handles a page fault at FAULT_ADDR, a user address that the
+   running process tried to access, for writing if WRITE is true.
+   Brings the page in if it is not present, and gives the process
+   its own copy if it is writing a page that it shares.  If the
+   page loads from a file, also maps pages around it.  Returns
+   true if successful, false if FAULT_ADDR is not part of the
+   process's address space, the access is not allowed, or the
+   page cannot be loaded. */
+bool
+page_in (void *fault_addr, bool write)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_for_addr (fault_addr);
+  bool from_file;
+  size_t mapped;
+
+  if (p == NULL || (write && !p->writable))
+    return false;
+
+  /* Checked without P's frame lock, so eviction may make this
+     wrong, but it only feeds statistics and the window. */
+  from_file = (p->frame == NULL && p->file != NULL
+               && p->swap_slot == SWAP_SLOT_NONE);
+  if (!lock_and_map (p, write))
+    return false;
+  frame_unlock (p->frame);
+
+  t->fault_cnt++;
+  if (from_file)
+    {
+      t->file_fault_cnt++;
+      if (p->upage == t->around_next)
+        t->around_window = (t->around_window == 0 ? 1
+                            : t->around_window < AROUND_MAX
+                            ? t->around_window * 2 : AROUND_MAX);
+      else
+        t->around_window /= 2;
+      mapped = fault_around (p, t->around_window);
+      t->around_cnt += mapped;
+      t->around_next = (uint8_t *) p->upage + (mapped + 1) * PGSIZE;
+    }
+  return true;
+}
+
+/* Returns true if P, whose frame the caller must have locked,
+   has been accessed since the last call for it, and clears its
+   accessed bit. */
+bool
+page_accessed_recently (struct page *p)
+{
+  uint32_t *pd = p->thread->pagedir;
+  bool accessed;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  accessed = pagedir_is_accessed (pd, p->upage);
+  if (accessed)
+    pagedir_set_accessed (pd, p->upage, false);
+  return accessed;
+}
+
+/* Removes all the pages that share F, which the caller must have
+   locked, leaving them without a frame and F free. */
+static void
+evict_frame (struct frame *f)
+{
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_front (&f->pages),
+                                   struct page, frame_elem);
+      frame_detach (f, p);
+      p->frame = NULL;
+    }
+}
+
+/* Unmaps every page that shares F, which the caller must have
+   locked, and returns true if any of them was dirty. */
+static bool
+unmap_frame (struct frame *f)
+{
+  bool dirty = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+
+      pagedir_clear_page (pd, p->upage);
+      if (pagedir_is_dirty (pd, p->upage))
+        dirty = true;
+    }
+  return dirty;
+}
+
+/* Maps every page that shares F, which the caller must have
+   locked, with dirty bit DIRTY.  Returns false if memory for a
+   page table could not be allocated, in which case the page it
+   was for stays unmapped until its next fault. */
+static bool
+map_frame (struct frame *f, bool dirty)
+{
+  bool success = true;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (!map_page (list_entry (e, struct page, frame_elem), dirty))
+      success = false;
+  return success;
+}
+
+/* Evicts the pages in the CNT frames in FRAMES, at most
+   SWAP_CLUSTER, which the caller must have locked.  Each page
+   is unmapped first, so that if its process touches it again,
+   it faults and waits on the frame lock until eviction is done.
+   Modified pages of memory-mapped files are written back to the
+   file, other modified frames are written to swap together, and
+   unmodified frames are dropped.  On return, each evicted frame
+   is free.  A frame that could not be written because swap is
+   full keeps its pages, which stay mapped. */
+void
+page_out (struct frame *frames[], size_t cnt)
+{
+  struct frame *dirty[SWAP_CLUSTER];
+  size_t dirty_cnt = 0;
+  size_t written;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct frame *f = frames[i];
+      struct page *first;
+      bool is_dirty;
+      struct list_elem *e;
+
+      ASSERT (lock_held_by_current_thread (&f->lock));
+      ASSERT (!list_empty (&f->pages));
+
+      /* Unmap before checking the dirty bits, so that no process
+         can dirty the frame after we look. */
+      is_dirty = unmap_frame (f);
+
+      first = list_entry (list_front (&f->pages), struct page, frame_elem);
+      if (first->write_back)
+        {
+          /* Memory-mapped pages are never shared. */
+          if (is_dirty)
+            file_write_at (first->file, f->base, first->read_bytes,
+                           first->file_ofs);
+          evict_frame (f);
+        }
+      else if (is_dirty)
+        {
+          /* Any copies in swap are now stale. */
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            {
+              struct page *p = list_entry (e, struct page, frame_elem);
+              if (p->swap_slot != SWAP_SLOT_NONE)
+                {
+                  swap_free (p->swap_slot);
+                  p->swap_slot = SWAP_SLOT_NONE;
+                }
+            }
+          dirty[dirty_cnt++] = f;
+        }
+      else
+        evict_frame (f);
+    }
+
+  written = swap_out (dirty, dirty_cnt);
+  for (i = 0; i < dirty_cnt; i++)
+    {
+      struct frame *f = dirty[i];
+      if (i < written)
+        evict_frame (f);
+      else
+        {
+          /* Put its pages back, still marked dirty. */
+          map_frame (f, true);
+        }
+    }
+}
+
+/* Returns true if F, which the caller must have locked, holds
+   pages that may be merged with others: ones that are not
+   memory-mapped from a file or kept in the cache of executable
+   pages, in a frame that no system call has pinned. */
+static bool
+mergeable (struct frame *f)
+{
+  struct list_elem *e;
+
+  if (list_empty (&f->pages) || f->share != NULL || f->pin_cnt > 0)
+    return false;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (list_entry (e, struct page, frame_elem)->write_back)
+      return false;
+  return true;
+}
+
+/* If frames A and B, which the caller must have locked, hold
+   identical contents, moves all of B's pages to A, where they
+   share A copy-on-write, and returns true.  B is then free.
+   Otherwise, or if either frame holds pages that may not be
+   merged, returns false and changes nothing.
+
+   Each page in A or B is clean only if its copy in swap or in
+   its file is identical to the frame.  That stays true for all
+   of them after the merge, so they only need to be marked dirty
+   if any of them was. */
+bool
+page_merge (struct frame *a, struct frame *b)
+{
+  bool dirty_a, dirty_b;
+
+  ASSERT (lock_held_by_current_thread (&a->lock));
+  ASSERT (lock_held_by_current_thread (&b->lock));
+  ASSERT (a != b);
+
+  if (!mergeable (a) || !mergeable (b)
+      || memcmp (a->base, b->base, PGSIZE))
+    return false;
+
+  /* Compare again with both unmapped, so that no process can
+     write to them in between. */
+  dirty_a = unmap_frame (a);
+  dirty_b = unmap_frame (b);
+  if (memcmp (a->base, b->base, PGSIZE))
+    {
+      map_frame (a, dirty_a);
+      map_frame (b, dirty_b);
+      return false;
+    }
+
+  while (!list_empty (&b->pages))
+    {
+      struct page *p = list_entry (list_front (&b->pages),
+                                   struct page, frame_elem);
+      frame_detach (b, p);
+      p->frame = a;
+      frame_attach (a, p);
+    }
+  map_frame (a, dirty_a || dirty_b);
+  return true;
+}
+
+/* Locks the page containing user address ADDR into memory, so
+   that the kernel can access it without faulting and it cannot
+   be evicted, until a matching call to page_unlock().  If
+   WILL_WRITE is true, the page must be writable.  Returns true
+   if successful, false if ADDR is not a valid address for the
+   access. */
+bool
+page_lock (const void *addr, bool will_write)
+{
+  struct page *p = page_for_addr (addr);
+
+  if (p == NULL || (will_write && !p->writable)
+      || !lock_and_map (p, will_write))
+    return false;
+
+  /* Pin the frame rather than keep it locked, so that locking
+     another page that shares it, or locking pages in any order,
+     cannot deadlock. */
+  frame_pin (p->frame);
+  frame_unlock (p->frame);
+  return true;
+}
+
+/* Unlocks the page containing ADDR, locked with page_lock(). */
+void
+page_unlock (const void *addr)
+{
+  struct page *p = page_for_addr (addr);
+
+  ASSERT (p != NULL && p->frame != NULL);
+  frame_unpin (p->frame);
+}
+
+/* Locks each page in the SIZE bytes starting at user address
+   ADDR, as page_lock() does.  Returns true if successful.  On
+   failure, no pages are left locked. */
+bool
+page_lock_range (const void *addr, size_t size, bool will_write)
+{
+  const uint8_t *start = pg_round_down (addr);
+  const uint8_t *end = (const uint8_t *) addr + size;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  if (end < (const uint8_t *) addr)
+    return false;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+    if (!page_lock (upage, will_write))
+      {
+        while (upage > start)
+          {
+            upage -= PGSIZE;
+            page_unlock (upage);
+          }
+        return false;
+      }
+  return true;
+}
+
+/* Unlocks each page in the SIZE bytes starting at user address
+   ADDR, locked with page_lock_range(). */
+void
+page_unlock_range (const void *addr, size_t size)
+{
+  const uint8_t *end = (const uint8_t *) addr + size;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return;
+  for (upage = pg_round_down (addr); upage < end; upage += PGSIZE)
+    page_unlock (upage);
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Unmaps the page that E refers to and frees it, its frame, and
+   its swap slot, writing it back first if it is a modified page
+   of a memory-mapped file.  Used as a callback for
+   hash_destroy(). */
+static void
+destroy_page (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      uint32_t *pd = p->thread->pagedir;
+
+      pagedir_clear_page (pd, p->upage);
+      if (p->write_back && pagedir_is_dirty (pd, p->upage))
+        file_write_at (p->file, p->frame->base, p->read_bytes, p->file_ofs);
+      frame_release (p->frame, p);
+    }
+  if (p->swap_slot != SWAP_SLOT_NONE)
+    swap_free (p->swap_slot);
+  free (p);
+}
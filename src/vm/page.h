@@ -0,0 +1,57 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+/* A page of user virtual memory, as recorded in its process's
+   supplemental page table. */
+struct page
+  {
+    struct hash_elem hash_elem; /* Element in thread's page table. */
+    void *upage;                /* User virtual address. */
+    struct thread *thread;      /* Owning thread. */
+    bool writable;              /* May the process write it? */
+    struct frame *frame;        /* Frame holding it, or null. */
+    struct list_elem frame_elem; /* Element in frame's page list. */
+    size_t swap_slot;           /* Copy in swap, or SWAP_SLOT_NONE. */
+
+    /* Initial contents, used while the page has no copy in swap:
+       the first READ_BYTES bytes come from FILE at offset
+       FILE_OFS and the rest are zero.  A page without a FILE is
+       entirely zero. */
+    struct file *file;          /* File to read, or null. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read from FILE. */
+    bool write_back;            /* Write changes to FILE, not swap? */
+    bool executable;            /* FILE is a program or library? */
+  };
+
+/* Maximum size of a user stack, in pages. */
+extern size_t stack_page_limit;
+
+/* Print each process's page fault statistics when it exits? */
+extern bool print_fault_stats;
+
+bool page_table_create (void);
+bool page_table_copy (struct thread *parent);
+void page_table_destroy (void);
+void page_print_stats (void);
+bool page_table_walk (bool (*) (struct page *, void *aux), void *aux);
+
+struct page *page_allocate (void *upage, bool writable);
+void page_deallocate (void *upage);
+struct page *page_for_addr (const void *);
+bool page_in (void *fault_addr, bool write);
+bool page_accessed_recently (struct page *);
+void page_out (struct frame *[], size_t cnt);
+bool page_merge (struct frame *, struct frame *);
+
+bool page_lock (const void *, bool will_write);
+void page_unlock (const void *);
+bool page_lock_range (const void *, size_t, bool will_write);
+void page_unlock_range (const void *, size_t);
+
+#endif /* vm/page.h */
@@ -0,0 +1,236 @@
+#include "vm/share.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Read-only pages of executables are shared by all the processes
+   that run the same program.  This cache maps each such page,
+   identified by its file's inode sector and its offset in the
+   file, to the frame that holds it, so that the second process
+   to touch the page finds it in memory instead of reading its
+   own copy from disk.  The list of pages in the frame serves as
+   the reference count.
+
+   A frame stays cached after the last process using it exits, so
+   that running the program again skips the disk entirely, until
+   the frame table needs the frame for something else.  The cache
+   keeps the inode open meanwhile, and notes how many times it
+   has been written, so that a page cached from an old version of
+   the file is never handed out.
+
+   Lock order: a frame's lock before share_lock. */
+
+/* A cached page. */
+struct share
+  {
+    struct hash_elem elem;      /* Element in shares. */
+    block_sector_t sector;      /* Inode sector of file. */
+    off_t ofs;                  /* Offset of page in file. */
+    struct inode *inode;        /* File's inode, kept open. */
+    size_t read_bytes;          /* Bytes of the page read from file. */
+    unsigned write_cnt;         /* Inode's write count when read. */
+    struct frame *frame;        /* Frame holding the page. */
+  };
+
+static struct hash shares;      /* Cached pages. */
+static struct lock share_lock;  /* Protects shares. */
+
+/* Updated with interrupts off, since some updates are made
+   without share_lock. */
+static long long hit_cnt;       /* Pages found in the cache. */
+static long long miss_cnt;      /* Shareable pages not found. */
+
+static unsigned share_hash (const struct hash_elem *, void *);
+static bool share_less (const struct hash_elem *, const struct hash_elem *,
+                        void *);
+
+/* Initializes the cache of shared executable pages. */
+void
+share_init (void)
+{
+  if (!hash_init (&shares, share_hash, share_less, NULL))
+    PANIC ("couldn't create shared page table");
+  lock_init (&share_lock);
+}
+
+/* Returns true if P may share its frame through the cache: it is
+   read-only, so it never changes, and loads from a file. */
+static bool
+is_shareable (const struct page *p)
+{
+  return !p->writable && p->file != NULL;
+}
+
+/* Counts a lookup in the cache, a hit if HIT is true. */
+static void
+count_lookup (bool hit)
+{
+  enum intr_level old_level = intr_disable ();
+  if (hit)
+    hit_cnt++;
+  else
+    miss_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Looks for a frame that holds the contents of P, which must not
+   be resident.  If one is cached, adds P to it and returns it,
+   locked.  Otherwise, returns a null pointer. */
+struct frame *
+share_lookup (struct page *p)
+{
+  struct inode *inode;
+  struct share key;
+  struct hash_elem *e;
+  struct frame *f = NULL;
+  struct share *s;
+
+  if (!is_shareable (p))
+    return NULL;
+
+  inode = file_get_inode (p->file);
+  key.sector = inode_get_inumber (inode);
+  key.ofs = p->file_ofs;
+  lock_acquire (&share_lock);
+  e = hash_find (&shares, &key.elem);
+  if (e != NULL)
+    f = hash_entry (e, struct share, elem)->frame;
+  lock_release (&share_lock);
+  if (f == NULL || lock_held_by_current_thread (&f->lock))
+    {
+      count_lookup (false);
+      return NULL;
+    }
+
+  /* The frame may be being loaded, in which case we wait for the
+     load to finish, or evicted, in which case it is no longer
+     cached once we get the lock. */
+  lock_acquire (&f->lock);
+  s = f->share;
+  if (s == NULL || s->sector != key.sector || s->ofs != key.ofs
+      || s->read_bytes != p->read_bytes)
+    {
+      lock_release (&f->lock);
+      count_lookup (false);
+      return NULL;
+    }
+  if (s->write_cnt != inode_write_cnt (inode))
+    {
+      /* The file changed since the page was read. */
+      struct inode *stale = share_remove (f);
+      lock_release (&f->lock);
+      inode_close (stale);
+      count_lookup (false);
+      return NULL;
+    }
+
+  count_lookup (true);
+  frame_attach (f, p);
+  p->frame = f;
+  return f;
+}
+
+/* Caches F, which the caller must have locked and just filled
+   with the contents of P, for other processes that run the same
+   program.  Does nothing if P cannot be shared, if another frame
+   already caches the same page, or if memory is short. */
+void
+share_add (struct frame *f, struct page *p)
+{
+  struct share *s;
+  struct inode *inode;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->share == NULL);
+
+  if (!is_shareable (p))
+    return;
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    return;
+  inode = file_get_inode (p->file);
+  s->sector = inode_get_inumber (inode);
+  s->ofs = p->file_ofs;
+  s->inode = inode;
+  s->read_bytes = p->read_bytes;
+  s->write_cnt = inode_write_cnt (inode);
+  s->frame = f;
+
+  lock_acquire (&share_lock);
+  if (hash_insert (&shares, &s->elem) != NULL)
+    {
+      lock_release (&share_lock);
+      free (s);
+      return;
+    }
+  f->share = s;
+  lock_release (&share_lock);
+  inode_reopen (inode);
+}
+
+/* Removes F, which the caller must have locked, from the cache,
+   if it is cached.  Pages that share F keep it.  Returns the
+   inode that the cache kept open for F, or a null pointer if F
+   was not cached.  Closing it may write to disk, so the caller
+   must close it with inode_close() only after releasing its
+   locks. */
+struct inode *
+share_remove (struct frame *f)
+{
+  struct share *s = f->share;
+  struct inode *inode;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (s == NULL)
+    return NULL;
+
+  lock_acquire (&share_lock);
+  hash_delete (&shares, &s->elem);
+  f->share = NULL;
+  lock_release (&share_lock);
+
+  inode = s->inode;
+  free (s);
+  return inode;
+}
+
+/* Prints statistics for the cache of executable pages. */
+void
+share_print_stats (void)
+{
+  long long lookups = hit_cnt + miss_cnt;
+
+  printf ("Shared pages: %lld lookups, %lld hits (%lld%%)\n",
+          lookups, hit_cnt, lookups > 0 ? hit_cnt * 100 / lookups : 0);
+}
+
+/* Returns a hash value for the cached page that E refers to. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct share *s = hash_entry (e, struct share, elem);
+  return hash_int (s->sector ^ ((s->ofs / PGSIZE) << 16));
+}
+
+/* Returns true if cached page A precedes cached page B. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct share *a = hash_entry (a_, struct share, elem);
+  const struct share *b = hash_entry (b_, struct share, elem);
+
+  if (a->sector != b->sector)
+    return a->sector < b->sector;
+  return a->ofs < b->ofs;
+}
@@ -0,0 +1,14 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+struct frame;
+struct inode;
+struct page;
+
+void share_init (void);
+struct frame *share_lookup (struct page *);
+void share_add (struct frame *, struct page *);
+struct inode *share_remove (struct frame *);
+void share_print_stats (void);
+
+#endif /* vm/share.h */
@@ -0,0 +1,417 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Swap space is the block device in the BLOCK_SWAP role, divided
+   into page-size slots.  A bitmap tracks which slots are in
+   use.  A slot may hold a page shared by several processes after
+   fork(), so each slot also has a count of the pages that refer
+   to it, and is freed when the last of them lets go.
+
+   In front of the device sits a cache of compressed pages in a
+   pool of kernel memory.  A page written to a slot is compressed
+   into the pool instead of being written to the device, if it
+   compresses well enough.  When the pool fills up, the pages
+   that entered it longest ago are written out to their slots on
+   the device to make room, so that only the coldest pages ever
+   cost disk I/O.  Reading a slot decompresses its page from the
+   pool, if it is there, and leaves it as the first candidate to
+   be written out, since the page is now in memory anyway.
+
+   Writing a page out happens without cache_lock or swap_lock, so
+   that other processes can keep swapping meanwhile.  Its slot
+   stays reserved until the write completes: a read of the slot
+   waits for it, and if the slot is freed meanwhile, the writer
+   releases it afterward instead.
+
+   Lock order: swap_lock before cache_lock. */
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;       /* Swap device, or null. */
+static struct bitmap *swap_bitmap;      /* Slots in use. */
+static uint16_t *swap_refs;             /* Pages referring to each slot. */
+static struct lock swap_lock;           /* Protects the above. */
+
+/* Size of the compressed cache, in pages.  0 disables it. */
+size_t swap_cache_pages = SWAP_CACHE_DEFAULT;
+
+/* The cache pool is divided into chunks of this many bytes, and
+   each compressed page occupies a run of consecutive chunks. */
+#define CHUNK_SIZE 64
+
+/* Pages that do not compress to at most this many bytes are
+   written straight to the device. */
+#define MAX_COMPRESSED (PGSIZE - PGSIZE / 4)
+
+/* A slot's page in the compressed cache. */
+struct cached
+  {
+    struct list_elem elem;      /* Element in cache_lru. */
+    size_t chunk;               /* First chunk in the pool. */
+    size_t size;                /* Compressed size, 0 if not cached. */
+    bool writing;               /* Being written out to the device? */
+    bool freed;                 /* Freed while being written out? */
+  };
+
+static uint8_t *cache_pool;             /* Compressed pages. */
+static struct bitmap *cache_chunks;     /* Chunks of pool in use. */
+static struct cached *cache_slots;      /* Cache entry for each slot. */
+static struct list cache_lru;           /* Cached pages, oldest first. */
+static void *cache_work;                /* Compressor scratch space. */
+static void *cache_buffer;              /* Page being compressed. */
+static void *cache_spill;               /* Page being written back. */
+static bool cache_spilling;             /* Is cache_spill in use? */
+static struct condition cache_written;  /* A write back finished. */
+static struct lock cache_lock;          /* Protects the above. */
+
+static void cache_init (size_t slot_cnt);
+static bool cache_store (size_t slot, const void *);
+static bool cache_load (size_t slot, void *);
+static bool cache_drop (size_t slot);
+static void write_slot (size_t slot, const void *);
+static void write_device (size_t slot, const void *);
+
+/* Sets up swap on the BLOCK_SWAP device.  Without one, pages
+   that have no other backing store can never be evicted. */
+void
+swap_init (void)
+{
+  size_t slot_cnt;
+
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    printf ("swap: no swap device; anonymous pages cannot be evicted\n");
+  slot_cnt = swap_device != NULL ? block_size (swap_device) / PAGE_SECTORS : 0;
+  swap_bitmap = bitmap_create (slot_cnt);
+  swap_refs = calloc (slot_cnt, sizeof *swap_refs);
+  if (swap_bitmap == NULL || (slot_cnt > 0 && swap_refs == NULL))
+    PANIC ("couldn't create swap bitmap");
+  lock_init (&swap_lock);
+  cache_init (slot_cnt);
+}
+
+/* Sets up the compressed cache for SLOT_CNT slots, if it is
+   enabled and memory allows. */
+static void
+cache_init (size_t slot_cnt)
+{
+  size_t chunk_cnt = swap_cache_pages * (PGSIZE / CHUNK_SIZE);
+
+  lock_init (&cache_lock);
+  cond_init (&cache_written);
+  list_init (&cache_lru);
+  if (slot_cnt == 0 || swap_cache_pages == 0)
+    return;
+
+  cache_pool = palloc_get_multiple (0, swap_cache_pages);
+  cache_chunks = bitmap_create (chunk_cnt);
+  cache_slots = calloc (slot_cnt, sizeof *cache_slots);
+  cache_work = malloc (LZ_WORK_SIZE);
+  cache_buffer = palloc_get_page (0);
+  cache_spill = palloc_get_page (0);
+  if (cache_pool == NULL || cache_chunks == NULL || cache_slots == NULL
+      || cache_work == NULL || cache_buffer == NULL || cache_spill == NULL)
+    {
+      printf ("swap: no memory for %zu-page compressed cache\n",
+              swap_cache_pages);
+      if (cache_pool != NULL)
+        palloc_free_multiple (cache_pool, swap_cache_pages);
+      if (cache_chunks != NULL)
+        bitmap_destroy (cache_chunks);
+      free (cache_slots);
+      free (cache_work);
+      palloc_free_page (cache_buffer);
+      palloc_free_page (cache_spill);
+      cache_pool = NULL;
+      return;
+    }
+  printf ("swap: %zu-page compressed cache\n", swap_cache_pages);
+}
+
+/* Writes the CNT frames in FRAMES, which the caller must have
+   locked, to swap and records the slot used in each page that
+   shares each frame.  The frames are written to consecutive
+   slots if a long enough run is free, so that they go out in one
+   sequential transfer.  Returns the number of frames written,
+   which is less than CNT only if swap is full; in that case the
+   frames at the end of FRAMES were not written. */
+size_t
+swap_out (struct frame *frames[], size_t cnt)
+{
+  size_t first, i;
+
+  lock_acquire (&swap_lock);
+  first = bitmap_scan_and_flip (swap_bitmap, 0, cnt, false);
+  lock_release (&swap_lock);
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct frame *f = frames[i];
+      struct list_elem *e;
+      size_t slot;
+
+      ASSERT (lock_held_by_current_thread (&f->lock));
+
+      if (first != BITMAP_ERROR)
+        slot = first + i;
+      else
+        {
+          /* No run long enough: fall back to single slots. */
+          lock_acquire (&swap_lock);
+          slot = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+          lock_release (&swap_lock);
+          if (slot == BITMAP_ERROR)
+            break;
+        }
+
+      write_slot (slot, f->base);
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          ASSERT (p->swap_slot == SWAP_SLOT_NONE);
+          p->swap_slot = slot;
+          swap_refs[slot]++;
+        }
+    }
+  return i;
+}
+
+/* Reads P's swap slot into P's frame, which the caller must have
+   locked.  The slot stays allocated, so that P can be evicted
+   again without a write as long as it is not modified. */
+void
+swap_in (struct page *p)
+{
+  size_t i;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+  ASSERT (p->swap_slot != SWAP_SLOT_NONE);
+
+  if (cache_load (p->swap_slot, p->frame->base))
+    return;
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_read (swap_device, p->swap_slot * PAGE_SECTORS + i,
+                (uint8_t *) p->frame->base + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Adds a reference to SLOT, for a page that shares the copy in
+   it with another. */
+void
+swap_dup (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_bitmap, slot));
+  ASSERT (swap_refs[slot] < UINT16_MAX);
+  swap_refs[slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to SLOT, releasing it for reuse when no
+   page refers to it any longer. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_bitmap, slot));
+  ASSERT (swap_refs[slot] > 0);
+  if (--swap_refs[slot] == 0 && cache_drop (slot))
+    bitmap_reset (swap_bitmap, slot);
+  lock_release (&swap_lock);
+}
+
+/* Writes the page at BASE to SLOT, in the compressed cache if
+   possible or else on the device. */
+static void
+write_slot (size_t slot, const void *base)
+{
+  if (!cache_store (slot, base))
+    write_device (slot, base);
+}
+
+/* Writes the page at BASE to SLOT on the device. */
+static void
+write_device (size_t slot, const void *base)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_write (swap_device, slot * PAGE_SECTORS + i,
+                 (const uint8_t *) base + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Removes SLOT's page from the compressed cache, if it is there.
+   The caller must hold cache_lock. */
+static void
+evict_cached (size_t slot)
+{
+  struct cached *c = &cache_slots[slot];
+
+  if (c->size > 0)
+    {
+      list_remove (&c->elem);
+      bitmap_set_multiple (cache_chunks, c->chunk,
+                           DIV_ROUND_UP (c->size, CHUNK_SIZE), false);
+      c->size = 0;
+    }
+}
+
+/* Writes the page that entered the compressed cache longest ago
+   out to its slot on the device, and removes it from the cache.
+   The caller must hold cache_lock, which is released during the
+   write, so anything it protects may change meanwhile.  Returns
+   false, without writing, if another write back is using
+   cache_spill. */
+static bool
+write_back_oldest (void)
+{
+  struct cached *c = list_entry (list_front (&cache_lru),
+                                 struct cached, elem);
+  size_t slot = c - cache_slots;
+  size_t size;
+  bool freed;
+
+  if (cache_spilling)
+    return false;
+  size = lz_decompress (cache_pool + c->chunk * CHUNK_SIZE, c->size,
+                        cache_spill, PGSIZE);
+  ASSERT (size == PGSIZE);
+  evict_cached (slot);
+  c->writing = true;
+  cache_spilling = true;
+  lock_release (&cache_lock);
+
+  write_device (slot, cache_spill);
+
+  lock_acquire (&cache_lock);
+  cache_spilling = false;
+  c->writing = false;
+  freed = c->freed;
+  c->freed = false;
+  cond_broadcast (&cache_written, &cache_lock);
+  if (freed)
+    {
+      /* swap_free() left releasing the slot to us. */
+      lock_release (&cache_lock);
+      lock_acquire (&swap_lock);
+      bitmap_reset (swap_bitmap, slot);
+      lock_release (&swap_lock);
+      lock_acquire (&cache_lock);
+    }
+  return true;
+}
+
+/* Tries to store the page at BASE in the compressed cache as
+   SLOT's contents, writing older pages out to the device to make
+   room if necessary.  Returns false if the cache is disabled, the
+   page does not compress well, or no room can be made. */
+static bool
+cache_store (size_t slot, const void *base)
+{
+  size_t size, chunk_cnt, chunk;
+
+  if (cache_pool == NULL)
+    return false;
+
+  lock_acquire (&cache_lock);
+  ASSERT (cache_slots[slot].size == 0 && !cache_slots[slot].writing);
+  for (;;)
+    {
+      /* Compress again after each write back, since another
+         thread may have used cache_buffer while it ran. */
+      size = lz_compress (base, PGSIZE, cache_buffer, MAX_COMPRESSED,
+                          cache_work);
+      if (size == 0)
+        {
+          lock_release (&cache_lock);
+          return false;
+        }
+
+      chunk_cnt = DIV_ROUND_UP (size, CHUNK_SIZE);
+      chunk = bitmap_scan_and_flip (cache_chunks, 0, chunk_cnt, false);
+      if (chunk != BITMAP_ERROR)
+        break;
+      if (list_empty (&cache_lru) || !write_back_oldest ())
+        {
+          lock_release (&cache_lock);
+          return false;
+        }
+    }
+
+  memcpy (cache_pool + chunk * CHUNK_SIZE, cache_buffer, size);
+  cache_slots[slot].chunk = chunk;
+  cache_slots[slot].size = size;
+  list_push_back (&cache_lru, &cache_slots[slot].elem);
+  lock_release (&cache_lock);
+  return true;
+}
+
+/* Reads SLOT's page into BASE from the compressed cache.  Returns
+   false if it is not in the cache, in which case it is on the
+   device. */
+static bool
+cache_load (size_t slot, void *base)
+{
+  struct cached *c;
+  bool cached;
+
+  if (cache_pool == NULL)
+    return false;
+
+  lock_acquire (&cache_lock);
+  c = &cache_slots[slot];
+  while (c->writing)
+    cond_wait (&cache_written, &cache_lock);
+  cached = c->size > 0;
+  if (cached)
+    {
+      size_t size = lz_decompress (cache_pool + c->chunk * CHUNK_SIZE,
+                                   c->size, base, PGSIZE);
+      ASSERT (size == PGSIZE);
+
+      /* The page is in a frame again, so keeping its compressed
+         copy is worth the least. */
+      list_remove (&c->elem);
+      list_push_front (&cache_lru, &c->elem);
+    }
+  lock_release (&cache_lock);
+  return cached;
+}
+
+/* Drops SLOT's page from the compressed cache, if it is there,
+   because SLOT has been freed.  The caller must hold swap_lock.
+   Returns true if SLOT may be reused at once, or false if it is
+   being written out, in which case the writer releases it once
+   it is done. */
+static bool
+cache_drop (size_t slot)
+{
+  struct cached *c;
+  bool reusable;
+
+  if (cache_pool == NULL)
+    return true;
+
+  lock_acquire (&cache_lock);
+  c = &cache_slots[slot];
+  evict_cached (slot);
+  reusable = !c->writing;
+  if (!reusable)
+    c->freed = true;
+  lock_release (&cache_lock);
+  return reusable;
+}
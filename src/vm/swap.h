@@ -0,0 +1,26 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+
+/* A swap slot that holds nothing. */
+#define SWAP_SLOT_NONE ((size_t) -1)
+
+/* Maximum number of pages written to swap at once. */
+#define SWAP_CLUSTER 8
+
+/* Default size of the compressed swap cache, in pages. */
+#define SWAP_CACHE_DEFAULT 64
+
+extern size_t swap_cache_pages;
+
+struct frame;
+struct page;
+
+void swap_init (void);
+size_t swap_out (struct frame *[], size_t cnt);
+void swap_in (struct page *);
+void swap_dup (size_t slot);
+void swap_free (size_t slot);
+
+#endif /* vm/swap.h */